@@ -41,6 +41,10 @@ public class NavVolume : ModuleRules
                 "SlateCore",
 				"Navmesh",
 				"NavigationSystem",
+				"Chaos",
+				"PhysicsCore",
+				"Landscape",
+				"Json",
 				// ... add private dependencies that you statically link with here ...	
 			}
 			);
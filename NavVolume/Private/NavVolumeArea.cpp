@@ -3,6 +3,8 @@
 #include "NavVolumeArea.h"
 #include "NavVolumeSubsystem.h"
 #include "Components/BrushComponent.h"
+#include "Misc/PackageName.h"
+#include "Misc/Paths.h"
 
 ANavVolumeArea::ANavVolumeArea(const FObjectInitializer& ObjectInitializer) : Super(ObjectInitializer)
 {
@@ -21,12 +23,97 @@ ANavVolumeArea::ANavVolumeArea(const FObjectInitializer& ObjectInitializer) : Su
 void ANavVolumeArea::BeginPlay()
 {
 	Super::BeginPlay();
-	GetWorld()->GetSubsystem<UNavVolumeSubsystem>()->CreateNavigableVolume(GetBrushComponent()->Bounds.GetBox());
+	RebuildNavigableVolume();
+	GetBrushComponent()->TransformUpdated.AddUObject(this, &ANavVolumeArea::OnAreaTransformUpdated);
+}
+
+void ANavVolumeArea::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	GetBrushComponent()->TransformUpdated.RemoveAll(this);
+	FTSTicker::GetCoreTicker().RemoveTicker(RebuildHandle);
+	RebuildHandle.Reset();
+
+	if (UNavVolumeSubsystem* Subsystem = GetWorld()->GetSubsystem<UNavVolumeSubsystem>(); Subsystem != nullptr && BuiltBounds.IsValid)
+	{
+		Subsystem->RemoveNavigableVolume(BuiltBounds);
+	}
+	
+	Super::EndPlay(EndPlayReason);
+}
+
+void ANavVolumeArea::RebuildNavigableVolume()
+{
+	UNavVolumeSubsystem* Subsystem = GetWorld() != nullptr ? GetWorld()->GetSubsystem<UNavVolumeSubsystem>() : nullptr;
+
+	if (Subsystem == nullptr)
+	{
+		return;
+	}
+	
+	if (BuiltBounds.IsValid)
+	{
+		Subsystem->RemoveNavigableVolume(BuiltBounds);
+	}
+	
+	NavVolume::Task::FVoxelizerSettings Settings;
+	Settings.bSolidInterior = bSolidInterior;
+	Settings.VoxelSize = VoxelSize;
+
+	// Sizes set from code or saved before they were checked never went through PostEditChangeProperty
+	if (!NavVolume::Voxel::IsSupportedVoxelSize(VoxelSize))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("%s: VoxelSize %d isn't supported (16, 32, 64 or 128), building with %d instead"),
+			*GetName(), VoxelSize, UNavVolumeSubsystem::DefaultVoxelSize);
+		Settings.VoxelSize = UNavVolumeSubsystem::DefaultVoxelSize;
+	}
+	Settings.AgentRadii = AgentRadii;
+
+	BuiltBounds = GetBrushComponent()->Bounds.GetBox();
+	Subsystem->CreateNavigableVolume(BuiltBounds, Settings, bUseCookedData ? GetCookedFilename() : FString());
+}
+
+void ANavVolumeArea::RequestRebuild()
+{
+	FTSTicker::GetCoreTicker().RemoveTicker(RebuildHandle);
+	RebuildHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateWeakLambda(this, [this](float)
+	{
+		RebuildHandle.Reset();
+		RebuildNavigableVolume();
+		return false;
+	}), RebuildDelay);
+}
+
+void ANavVolumeArea::OnAreaTransformUpdated(USceneComponent* Component, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport)
+{
+	UNavVolumeSubsystem* Subsystem = GetWorld() != nullptr ? GetWorld()->GetSubsystem<UNavVolumeSubsystem>() : nullptr;
+	const FBox NewBounds = GetBrushComponent()->Bounds.GetBox();
+
+	if (Subsystem == nullptr || !BuiltBounds.IsValid || BuiltBounds.Equals(NewBounds))
+	{
+		return;
+	}
+
+	Subsystem->MoveNavigableVolume(BuiltBounds, NewBounds);
+	BuiltBounds = NewBounds;
+}
+
+FString ANavVolumeArea::GetCookedFilename() const
+{
+	// PIE worlds are duplicates of the editor map - they share its file
+	const FString MapName = FPackageName::GetShortName(UWorld::RemovePIEPrefix(GetLevel()->GetOutermost()->GetName()));
+	return FPaths::ProjectContentDir() / TEXT("NavVolume") / FString::Printf(TEXT("%s_%s.navvolume"), *MapName, *GetName());
 }
 
 void ANavVolumeArea::PostRegisterAllComponents()
 {
 	Super::PostRegisterAllComponents();
+
+	// Components are registered again on most editor changes - only moving or resizing the area changes what has to be built.
+	// Rebuilding hashes the geometry and saves the cooked file, so it waits until the area settles.
+	if (GetWorld() != nullptr && GetWorld()->WorldType == EWorldType::Editor && !BuiltBounds.Equals(GetBrushComponent()->Bounds.GetBox()))
+	{
+		RequestRebuild();
+	}
 }
 
 void ANavVolumeArea::PostUnregisterAllComponents()
@@ -34,18 +121,30 @@ void ANavVolumeArea::PostUnregisterAllComponents()
 	Super::PostUnregisterAllComponents();
 }
 
+#if WITH_EDITOR
 void ANavVolumeArea::PostEditChangeProperty(struct FPropertyChangedEvent& PropertyChangedEvent)
 {
 	Super::PostEditChangeProperty(PropertyChangedEvent);
+
+	if (PropertyChangedEvent.GetPropertyName() == GET_MEMBER_NAME_CHECKED(ANavVolumeArea, VoxelSize) && !NavVolume::Voxel::IsSupportedVoxelSize(VoxelSize))
+	{
+		const int32 SupportedSize = NavVolume::Voxel::GetNearestSupportedVoxelSize(VoxelSize);
+		UE_LOG(LogTemp, Warning, TEXT("%s: VoxelSize %d isn't supported, using %d"), *GetName(), VoxelSize, SupportedSize);
+		VoxelSize = SupportedSize;
+	}
+
+	// Settings such as bSolidInterior change every node, not just a region
+	RequestRebuild();
 }
 
 void ANavVolumeArea::PostEditUndo()
 {
 	Super::PostEditUndo();
+	RequestRebuild();
 }
 
 void ANavVolumeArea::OnPostEngineInit()
 {
 	
 }
-
+#endif // WITH_EDITOR
@@ -0,0 +1,1032 @@
+//
+
+#include "NavVolumeBenchmarkCommandlet.h"
+#include "NavVolumeSubsystem.h"
+#include "Algo/BinarySearch.h"
+#include "Algo/Sort.h"
+#include "Algo/Unique.h"
+#include "Async/Async.h"
+#include "Async/ParallelFor.h"
+#include "Chaos/Convex.h"
+#include "Dom/JsonObject.h"
+#include "HAL/PlatformMemory.h"
+#include "Hash/xxhash.h"
+#include "Misc/EngineVersion.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+#include <atomic>
+
+namespace
+{
+	/** Settings of a run - every scene is generated from the seed so two runs with the same arguments time the same work. */
+	struct FBenchmarkSettings
+	{
+		int32 Seed = 1;
+		int32 NumShapes = 256;
+		int32 NumMortonCodes = 1 << 22;
+		int32 VoxelSize = UNavVolumeSubsystem::DefaultVoxelSize;
+
+		/** Shapes are scattered over a cube of this many voxels per axis. */
+		int32 SceneLog2Size = 9;
+
+		/** Code counts the merge of voxelizer runs is compared with appending and sorting them at. */
+		TArray<int32> MergeSizes = { 1000000, 10000000, 100000000 };
+	};
+
+	/** Correctness checks of a run - any failure makes the commandlet return an error, so a CI job running it fails. */
+	struct FBenchmarkChecks
+	{
+		TArray<FString> Failures;
+
+		void Check(const bool bPassed, const FString& Name)
+		{
+			if (!bPassed)
+			{
+				UE_LOG(LogTemp, Error, TEXT("NavVolumeBenchmark: check %s failed"), *Name);
+				Failures.Add(Name);
+			}
+		}
+	};
+
+	template<typename ElementType>
+	bool AreEqual(TConstArrayView<ElementType> A, TConstArrayView<ElementType> B)
+	{
+		if (A.Num() != B.Num())
+		{
+			return false;
+		}
+
+		for (int32 Index = 0; Index < A.Num(); ++Index)
+		{
+			if (!(A[Index] == B[Index])) return false;
+		}
+
+		return true;
+	}
+
+	const TCHAR* GetMortonBatchPathName(const NavVolume::Morton::EMortonBatchPath Path)
+	{
+		switch (Path)
+		{
+		case NavVolume::Morton::EMortonBatchPath::BMI2: return TEXT("BMI2");
+		case NavVolume::Morton::EMortonBatchPath::AVX2: return TEXT("AVX2");
+		default: return TEXT("Scalar");
+		}
+	}
+
+	constexpr NavVolume::Morton::EMortonBatchPath MortonBatchPaths[] = {
+		NavVolume::Morton::EMortonBatchPath::Scalar, NavVolume::Morton::EMortonBatchPath::BMI2, NavVolume::Morton::EMortonBatchPath::AVX2 };
+
+	template<typename FunctorType>
+	double TimeSeconds(FunctorType&& Functor)
+	{
+		const double StartTime = FPlatformTime::Seconds();
+		Functor();
+		return FMath::Max(FPlatformTime::Seconds() - StartTime, UE_DOUBLE_SMALL_NUMBER);
+	}
+
+	/** Adds one result as { "name", "items", "seconds", "itemsPerSecond" } - items are codes, voxels or nodes depending on the benchmark. */
+	void AddResult(TArray<TSharedPtr<FJsonValue>>& Results, const FString& Name, const int64 NumItems, const double Seconds)
+	{
+		const TSharedPtr<FJsonObject> Result = MakeShared<FJsonObject>();
+		Result->SetStringField(TEXT("name"), Name);
+		Result->SetNumberField(TEXT("items"), static_cast<double>(NumItems));
+		Result->SetNumberField(TEXT("seconds"), Seconds);
+		Result->SetNumberField(TEXT("itemsPerSecond"), NumItems / Seconds);
+		Results.Add(MakeShared<FJsonValueObject>(Result));
+
+		UE_LOG(LogTemp, Display, TEXT("NavVolumeBenchmark: %s - %lld items, %.3f ms, %.0f items/s"), *Name, NumItems, Seconds * 1000.0, NumItems / Seconds);
+	}
+
+	/** Voxels covered by a set of codes - every leaf, plus every voxel of the solid blocks. */
+	int64 CountVoxels(const NavVolume::Octree::FOctreeCodes& Codes)
+	{
+		int64 NumVoxels = Codes.Leaves.Num();
+
+		for (int32 Level = 0; Level < Codes.Solids.Num(); ++Level)
+		{
+			NumVoxels += static_cast<int64>(Codes.Solids[Level].Num()) << (3 * (Level + 1));
+		}
+
+		return NumVoxels;
+	}
+
+	bool IsSortedUnique(TConstArrayView<NavVolume::Morton::FMortonCode> Codes)
+	{
+		for (int32 Index = 1; Index < Codes.Num(); ++Index)
+		{
+			if (Codes[Index - 1] >= Codes[Index]) return false;
+		}
+
+		return true;
+	}
+
+	bool IsSortedUnique(const NavVolume::Octree::FOctreeCodes& Codes)
+	{
+		return IsSortedUnique(Codes.Leaves) && !Codes.Solids.ContainsByPredicate([](const TArray<NavVolume::Morton::FMortonCode>& Level) { return !IsSortedUnique(Level); });
+	}
+
+	/** Whether a voxel is covered by sorted codes - one of the leaves, or inside one of the solid blocks. */
+	bool IsOccupied(const NavVolume::Octree::FOctreeCodes& Codes, const NavVolume::Morton::FMortonCode Code)
+	{
+		if (Algo::BinarySearch(Codes.Leaves, Code) != INDEX_NONE)
+		{
+			return true;
+		}
+
+		for (int32 Level = 0; Level < Codes.Solids.Num(); ++Level)
+		{
+			if (Algo::BinarySearch(Codes.Solids[Level], Code >> (3 * (Level + 1))) != INDEX_NONE) return true;
+		}
+
+		return false;
+	}
+
+	/** Whether two sets of sorted codes cover the same voxels - every leaf and both corners of every block of each is looked up in the
+	 *	other, then random voxels of the bounds in both.
+	 */
+	template<int32 VoxelSize>
+	bool CoverSameVoxels(const NavVolume::Octree::FOctreeCodes& A, const NavVolume::Octree::FOctreeCodes& B, const FBox& Bounds, FRandomStream& Random)
+	{
+		std::atomic<bool> bSame = true;
+
+		const auto CheckCovered = [&bSame](const NavVolume::Octree::FOctreeCodes& From, const NavVolume::Octree::FOctreeCodes& Into)
+		{
+			ParallelFor(From.Leaves.Num(), [&](const int32 Index)
+			{
+				if (!IsOccupied(Into, From.Leaves[Index])) bSame = false;
+			});
+
+			for (int32 Level = 0; Level < From.Solids.Num(); ++Level)
+			{
+				ParallelFor(From.Solids[Level].Num(), [&](const int32 Index)
+				{
+					const NavVolume::Morton::FMortonCode First = From.Solids[Level][Index] << (3 * (Level + 1));
+					const NavVolume::Morton::FMortonCode Last = First + (NavVolume::Morton::FMortonCode(1) << (3 * (Level + 1))) - 1;
+					if (!IsOccupied(Into, First) || !IsOccupied(Into, Last)) bSame = false;
+				});
+			}
+		};
+
+		CheckCovered(A, B);
+		CheckCovered(B, A);
+
+		for (int32 Sample = 0; Sample < (1 << 16) && bSame; ++Sample)
+		{
+			const FVector Position(Random.FRandRange(Bounds.Min.X, Bounds.Max.X), Random.FRandRange(Bounds.Min.Y, Bounds.Max.Y), Random.FRandRange(Bounds.Min.Z, Bounds.Max.Z));
+			const NavVolume::Morton::FMortonCode Code = NavVolume::Morton::EncodeMorton(NavVolume::Voxel::QuantizeVoxel<VoxelSize>(Position));
+			bSame = IsOccupied(A, Code) == IsOccupied(B, Code);
+		}
+
+		return bSame;
+	}
+
+	/** The build as the subsystem runs it - BinShapes, TBinVoxelizer runs on the task graph, the merge (MergeUnique) and BuildTiles - timed
+	 *	stage by stage on the whole scene, and checked against the reference codes of the per shape voxelizers.
+	 */
+	template<int32 VoxelSize>
+	TSharedPtr<FJsonObject> BenchmarkPipeline(const FKAggregateGeom& Scene, const TArray<FVector>& Triangles, const FBox& SceneBounds, const NavVolume::Octree::FOctreeCodes& Reference,
+		FRandomStream& Random, TArray<TSharedPtr<FJsonValue>>& Results, FBenchmarkChecks& Checks)
+	{
+		using namespace NavVolume::BroadPhase;
+		using FTiledOctree = UNavVolumeSubsystem::TTiledOctree<VoxelSize>;
+
+		const TSharedPtr<FShapeSet> ShapeSet = MakeShared<FShapeSet>();
+		ShapeSet->AddTriangles(ShapeSet->AddComponent(FTransform::Identity, SceneBounds, Scene), CopyTemp(Triangles));
+
+		FNavVolumeBuildStats Stats;
+		Stats.NumComponents = ShapeSet->Components.Num();
+		Stats.NumShapes = ShapeSet->Shapes.Num();
+		TArray<FBin> Bins;
+
+		AddResult(Results, TEXT("Pipeline.BinShapes"), Stats.NumShapes, TimeSeconds([&]()
+		{
+			Bins = BinShapes<VoxelSize>(*ShapeSet);
+		}));
+
+		Stats.NumBins = Bins.Num();
+		const TSharedPtr<NavVolume::Stats::FVoxelizeCounters> Counters = MakeShared<NavVolume::Stats::FVoxelizeCounters>();
+		TArray<UNavVolumeSubsystem::FVoxelizeTask> VoxelizeTasks;
+
+		const double VoxelizeSeconds = TimeSeconds([&]()
+		{
+			const int32 NumRuns = FMath::Max(1, FTaskGraphInterface::Get().GetNumWorkerThreads() * 4);
+
+			for (TBinVoxelizer<VoxelSize>& Voxelizer : MakeBinVoxelizers<VoxelSize>(ShapeSet, MoveTemp(Bins), NumRuns, true, Counters))
+			{
+				VoxelizeTasks.Add(UE::Tasks::Launch(UE_SOURCE_LOCATION, MoveTemp(Voxelizer)));
+			}
+
+			UE::Tasks::Wait(VoxelizeTasks);
+		});
+
+		Counters->CopyTo(Stats);
+		Stats.NumVoxelizeTasks = VoxelizeTasks.Num();
+		AddResult(Results, TEXT("Pipeline.Voxelize"), Stats.NumVoxelsEmitted, VoxelizeSeconds);
+
+		TArray<NavVolume::Octree::FOctreeCodes> Runs;
+		bool bRunsSorted = true;
+
+		for (UNavVolumeSubsystem::FVoxelizeTask& Task : VoxelizeTasks)
+		{
+			Runs.Add(MoveTemp(Task.GetResult()));
+			bRunsSorted &= IsSortedUnique(Runs.Last());
+		}
+
+		Checks.Check(bRunsSorted, TEXT("Pipeline.RunsSorted"));
+		NavVolume::Octree::FOctreeCodes Codes;
+
+		Stats.MergeSeconds = TimeSeconds([&]()
+		{
+			Codes = NavVolume::Octree::FOctreeCodes::Merge(MoveTemp(Runs));
+		});
+
+		Stats.NumLeaves = Codes.Leaves.Num();
+		Stats.PeakCodeBytes += Codes.GetAllocatedSize();
+		Stats.PeakUsedPhysical = FPlatformMemory::GetStats().PeakUsedPhysical;
+		AddResult(Results, TEXT("Pipeline.Merge"), Stats.NumLeaves, Stats.MergeSeconds);
+
+		Checks.Check(IsSortedUnique(Codes), TEXT("Pipeline.MergeSorted"));
+		Checks.Check(CoverSameVoxels<VoxelSize>(Codes, Reference, SceneBounds, Random), TEXT("Pipeline.MatchesReference"));
+
+		// Split and built the way LaunchBuild does, tiles without geometry stay free space
+		const TSharedPtr<FTiledOctree> Volume = MakeShared<FTiledOctree>(UNavVolumeSubsystem::TileLog2Size);
+
+		// Two tiles past the scene are in the bounds but never have geometry - searches have to treat them as free space
+		const int32 TileSize = 1 << UNavVolumeSubsystem::TileLog2Size;
+		const FIntVector SceneMax = NavVolume::Voxel::QuantizeVoxel<VoxelSize>(SceneBounds.Max);
+		const FIntVector EmptyStart((((SceneMax.X >> UNavVolumeSubsystem::TileLog2Size) + 1) << UNavVolumeSubsystem::TileLog2Size) + TileSize / 2, SceneMax.Y / 2, SceneMax.Z / 2);
+		const FIntVector EmptyEnd = EmptyStart + FIntVector(TileSize, 0, 0);
+		const NavVolume::Morton::FMortonCode EmptyStartKey = NavVolume::Morton::EncodeMorton(EmptyStart) >> (3 * UNavVolumeSubsystem::TileLog2Size);
+		const NavVolume::Morton::FMortonCode EmptyEndKey = NavVolume::Morton::EncodeMorton(EmptyEnd) >> (3 * UNavVolumeSubsystem::TileLog2Size);
+		Volume->SetBounds(SceneBounds + Volume->GetTileBounds(EmptyEndKey));
+
+		const double TileSeconds = TimeSeconds([&]()
+		{
+			TMap<NavVolume::Morton::FMortonCode, NavVolume::Octree::FOctreeCodes> TileCodes = NavVolume::Tile::SplitTiles(MoveTemp(Codes), UNavVolumeSubsystem::TileLog2Size);
+			TArray<TPair<NavVolume::Morton::FMortonCode, NavVolume::Octree::FOctreeCodes>> Tiles;
+			Tiles.Reserve(TileCodes.Num());
+
+			for (TPair<NavVolume::Morton::FMortonCode, NavVolume::Octree::FOctreeCodes>& Tile : TileCodes)
+			{
+				Tiles.Emplace(Tile.Key, MoveTemp(Tile.Value));
+			}
+
+			Volume->BuildTiles(MoveTemp(Tiles), true, &Stats);
+		});
+
+		AddResult(Results, TEXT("Pipeline.BuildTiles"), Volume->NumTiles(), TileSeconds);
+
+		// The codes made back from the tile octrees (to splice updates into) have to cover what the tiles were built from
+		TArray<NavVolume::Octree::FOctreeCodes> RebuiltCodes;
+		bool bTileCodesInTile = true;
+
+		for (const typename FTiledOctree::FTile& Tile : Volume->GetTiles())
+		{
+			const NavVolume::Octree::FOctreeCodes& TileRebuilt = RebuiltCodes.Add_GetRef(Volume->GetTileCodes(Tile.Key));
+			bTileCodesInTile &= IsSortedUnique(TileRebuilt) && !TileRebuilt.Leaves.ContainsByPredicate([&Tile](const NavVolume::Morton::FMortonCode Leaf)
+			{
+				return Leaf >> (3 * UNavVolumeSubsystem::TileLog2Size) != Tile.Key;
+			});
+		}
+
+		Checks.Check(bTileCodesInTile && CoverSameVoxels<VoxelSize>(NavVolume::Octree::FOctreeCodes::Merge(MoveTemp(RebuiltCodes)), Reference, SceneBounds, Random),
+			TEXT("Pipeline.TileCodes"));
+
+		// Leaves are blocked and free voxels free through the links searches use, empty tiles included
+		bool bLinksMatch = true;
+		const int32 LeafStride = FMath::Max(1, Reference.Leaves.Num() / 4096);
+
+		for (int32 Index = 0; Index < Reference.Leaves.Num(); Index += LeafStride)
+		{
+			const FIntVector Voxel = NavVolume::Morton::DecodeMorton(Reference.Leaves[Index]);
+			bLinksMatch &= !Volume->IsLinkFree(Volume->FindLink(NavVolume::Voxel::GetVoxelRangeBounds<VoxelSize>(Voxel, Voxel).GetCenter()));
+		}
+
+		for (int32 Sample = 0; Sample < 4096; ++Sample)
+		{
+			const FVector Position(Random.FRandRange(SceneBounds.Min.X, SceneBounds.Max.X), Random.FRandRange(SceneBounds.Min.Y, SceneBounds.Max.Y), Random.FRandRange(SceneBounds.Min.Z, SceneBounds.Max.Z));
+			const FIntVector Voxel = NavVolume::Voxel::QuantizeVoxel<VoxelSize>(Position);
+			const bool bOccupied = IsOccupied(Reference, NavVolume::Morton::EncodeMorton(Voxel));
+			bLinksMatch &= bOccupied != Volume->IsLinkFree(Volume->FindLink(NavVolume::Voxel::GetVoxelRangeBounds<VoxelSize>(Voxel, Voxel).GetCenter()));
+		}
+
+		Checks.Check(bLinksMatch, TEXT("Pipeline.TileLinks"));
+
+		const FVector EmptyStartPosition = NavVolume::Voxel::GetVoxelRangeBounds<VoxelSize>(EmptyStart, EmptyStart).GetCenter();
+		const FVector EmptyEndPosition = NavVolume::Voxel::GetVoxelRangeBounds<VoxelSize>(EmptyEnd, EmptyEnd).GetCenter();
+		const NavVolume::Path::FPathResult EmptyPath = Volume->FindPath(EmptyStartPosition, EmptyEndPosition, NavVolume::Path::FPathSettings());
+
+		Checks.Check(Volume->FindTile(EmptyStartKey) == nullptr && Volume->FindTile(EmptyEndKey) == nullptr
+			&& Volume->IsEmptyTile(EmptyStartKey) && Volume->IsEmptyTile(EmptyEndKey)
+			&& Volume->IsLinkFree(Volume->FindLink(EmptyStartPosition)) && Volume->IsLinkFree(Volume->FindLink(EmptyEndPosition)), TEXT("Pipeline.EmptyTiles"));
+		Checks.Check(!Volume->Raycast(EmptyStartPosition, EmptyEndPosition).bBlocked, TEXT("Pipeline.EmptyTileRaycast"));
+		Checks.Check(EmptyPath.bSuccess && EmptyPath.Points.Num() >= 2 && EmptyPath.Points[0] == EmptyStartPosition && EmptyPath.Points.Last() == EmptyEndPosition,
+			TEXT("Pipeline.EmptyTilePath"));
+
+		const TSharedPtr<FJsonObject> Pipeline = MakeShared<FJsonObject>();
+		Pipeline->SetNumberField(TEXT("shapes"), Stats.NumShapes);
+		Pipeline->SetNumberField(TEXT("bins"), Stats.NumBins);
+		Pipeline->SetNumberField(TEXT("voxelizeTasks"), Stats.NumVoxelizeTasks);
+		Pipeline->SetNumberField(TEXT("duplicateRatio"), Stats.GetDuplicateRatio());
+		Pipeline->SetNumberField(TEXT("leaves"), static_cast<double>(Stats.NumLeaves));
+		Pipeline->SetNumberField(TEXT("tiles"), Volume->NumTiles());
+		Pipeline->SetNumberField(TEXT("runAllocations"), static_cast<double>(Stats.NumRunAllocations));
+		Pipeline->SetNumberField(TEXT("peakCodeBytes"), static_cast<double>(Stats.PeakCodeBytes));
+		Pipeline->SetNumberField(TEXT("volumeBytes"), static_cast<double>(Volume->GetAllocatedSize()));
+		return Pipeline;
+	}
+
+	/** A random 64-bit code in [Base, Base + 2^Log2Range). */
+	NavVolume::Morton::FMortonCode RandCode(FRandomStream& Random, const NavVolume::Morton::FMortonCode Base, const int32 Log2Range)
+	{
+		const NavVolume::Morton::FMortonCode Bits = static_cast<NavVolume::Morton::FMortonCode>(Random.GetUnsignedInt()) << 32 | Random.GetUnsignedInt();
+		return Base + (Bits & ((NavVolume::Morton::FMortonCode(1) << Log2Range) - 1));
+	}
+
+	/** The plain sort RadixSortUnique and both merges replace. */
+	void SortUniqueReference(TArray<NavVolume::Morton::FMortonCode>& Codes)
+	{
+		Algo::Sort(Codes);
+		Codes.SetNum(Algo::Unique(Codes));
+	}
+
+	/** Times the radix sort against Algo::Sort and checks it, and both merges, against sorting and removing duplicates.
+	 *	Codes share high bits like the codes of a small area, so the radix sort also skips digits, and the large inputs are merged in chunks.
+	 */
+	void CheckSort(const FBenchmarkSettings& Settings, TArray<TSharedPtr<FJsonValue>>& Results, FBenchmarkChecks& Checks)
+	{
+		using NavVolume::Morton::FMortonCode;
+		FRandomStream Random(Settings.Seed + 2);
+
+		const auto MakeCodes = [&Random](const int32 Num, const FMortonCode Base, const int32 Log2Range)
+		{
+			TArray<FMortonCode> Codes;
+			Codes.SetNumUninitialized(Num);
+			for (FMortonCode& Code : Codes) Code = RandCode(Random, Base, Log2Range);
+			return Codes;
+		};
+
+		for (const int32 Num : { 1 << 9, 1 << 14, Settings.NumMortonCodes })
+		{
+			// A range a few times the count leaves some duplicates
+			const TArray<FMortonCode> Codes = MakeCodes(Num, static_cast<FMortonCode>(Random.RandHelper(1 << 20)) << 40, FMath::CeilLogTwo(Num) + 2);
+			TArray<FMortonCode> Expected = Codes;
+			TArray<FMortonCode> Sorted = Codes;
+
+			AddResult(Results, FString::Printf(TEXT("AlgoSortUnique.%d"), Num), Num, TimeSeconds([&]() { SortUniqueReference(Expected); }));
+			AddResult(Results, FString::Printf(TEXT("RadixSortUnique.%d"), Num), Num, TimeSeconds([&]() { NavVolume::Sort::RadixSortUnique(Sorted); }));
+			Checks.Check(Sorted == Expected, FString::Printf(TEXT("RadixSortUnique.%d"), Num));
+		}
+
+		constexpr int32 NumMergeCodes = 1 << 18;
+		const FMortonCode MergeBase = static_cast<FMortonCode>(Random.RandHelper(1 << 20)) << 40;
+
+		// Overlapping runs and a run that starts after the other ends, which is copied rather than compared
+		const TPair<const TCHAR*, FMortonCode> MergeCases[] = { { TEXT("Overlapping"), 0 }, { TEXT("HalfOverlapping"), FMortonCode(1) << 20 }, { TEXT("Disjoint"), FMortonCode(1) << 21 } };
+
+		for (const TPair<const TCHAR*, FMortonCode>& MergeCase : MergeCases)
+		{
+			TArray<FMortonCode> A = MakeCodes(NumMergeCodes, MergeBase, 21);
+			TArray<FMortonCode> B = MakeCodes(NumMergeCodes, MergeBase + MergeCase.Value, 21);
+			SortUniqueReference(A);
+			SortUniqueReference(B);
+
+			TArray<FMortonCode> Expected = A;
+			Expected.Append(B);
+			SortUniqueReference(Expected);
+
+			TArray<FMortonCode> Merged;
+			AddResult(Results, FString::Printf(TEXT("MergeUnique.%s"), MergeCase.Key), A.Num() + B.Num(), TimeSeconds([&]() { NavVolume::Sort::MergeUnique(A, B, Merged); }));
+			Checks.Check(Merged == Expected, FString::Printf(TEXT("MergeUnique.%s"), MergeCase.Key));
+		}
+
+		// Runs of neighbouring bins - some overlap, some follow each other and are concatenated
+		TArray<TArray<FMortonCode>> Runs;
+		TArray<FMortonCode> Expected;
+
+		for (int32 RunIndex = 0; RunIndex < 16; ++RunIndex)
+		{
+			TArray<FMortonCode>& Run = Runs.Add_GetRef(MakeCodes(NumMergeCodes / 4, MergeBase + (static_cast<FMortonCode>(RunIndex / 2) << 20), RunIndex % 4 == 0 ? 21 : 20));
+			SortUniqueReference(Run);
+			Expected.Append(Run);
+		}
+
+		SortUniqueReference(Expected);
+		TArray<FMortonCode> Merged;
+		AddResult(Results, TEXT("MergeUnique.Runs"), Expected.Num(), TimeSeconds([&]() { Merged = NavVolume::Sort::MergeUnique(MoveTemp(Runs)); }));
+		Checks.Check(Merged == Expected, TEXT("MergeUnique.Runs"));
+	}
+
+	/** Runs the functor while a thread of its own polls the physical memory in use. Returns the seconds it took, OutPeakBytes is the most
+	 *	memory in use above what was in use before, to within the polling interval. Freed memory is trimmed first so the allocator's
+	 *	cache isn't counted as free.
+	 */
+	template<typename FunctorType>
+	double TimeSecondsAndPeakBytes(FunctorType&& Functor, uint64& OutPeakBytes)
+	{
+		FMemory::Trim();
+		const uint64 BaseBytes = FPlatformMemory::GetStats().UsedPhysical;
+		std::atomic<bool> bDone = false;
+		std::atomic<uint64> PeakBytes = BaseBytes;
+
+		TFuture<void> Sampler = Async(EAsyncExecution::Thread, [&bDone, &PeakBytes]()
+		{
+			while (!bDone)
+			{
+				PeakBytes = FMath::Max<uint64>(PeakBytes, FPlatformMemory::GetStats().UsedPhysical);
+				FPlatformProcess::Sleep(0.001f);
+			}
+		});
+
+		const double Seconds = TimeSeconds(Forward<FunctorType>(Functor));
+		bDone = true;
+		Sampler.Wait();
+
+		OutPeakBytes = FMath::Max<uint64>(PeakBytes, FPlatformMemory::GetStats().UsedPhysical) - BaseBytes;
+		return Seconds;
+	}
+
+	/** Merging the sorted runs of the voxelizers (MergeUnique) against appending them and sorting, as builds did before - wall time and
+	 *	peak bytes (the runs included) at every size of Settings.MergeSizes. Each run overlaps half of the next like the runs of neighbouring bins.
+	 */
+	TArray<TSharedPtr<FJsonValue>> BenchmarkMerge(const FBenchmarkSettings& Settings, TArray<TSharedPtr<FJsonValue>>& Results, FBenchmarkChecks& Checks)
+	{
+		using NavVolume::Morton::FMortonCode;
+		TArray<TSharedPtr<FJsonValue>> Merges;
+		const int32 NumRuns = FMath::Max(1, FTaskGraphInterface::Get().GetNumWorkerThreads() * 4);
+
+		for (const int32 NumCodes : Settings.MergeSizes)
+		{
+			const int32 RunSize = FMath::DivideAndRoundUp(FMath::Max(NumCodes, 1), NumRuns);
+			const int32 Log2Window = FMath::CeilLogTwo(RunSize) + 1;
+
+			// Made again for each side from the same seed rather than copied, so neither pays for the other's input
+			const auto MakeRuns = [&]()
+			{
+				FRandomStream Random(Settings.Seed + 4);
+				TArray<TArray<FMortonCode>> Runs;
+				Runs.SetNum(NumRuns);
+
+				for (int32 RunIndex = 0; RunIndex < NumRuns; ++RunIndex)
+				{
+					TArray<FMortonCode>& Run = Runs[RunIndex];
+					Run.SetNumUninitialized(RunSize);
+					for (FMortonCode& Code : Run) Code = RandCode(Random, static_cast<FMortonCode>(RunIndex) << (Log2Window - 1), Log2Window);
+					NavVolume::Sort::RadixSortUnique(Run);
+				}
+
+				return Runs;
+			};
+
+			const auto GetBytes = [](const TArray<TArray<FMortonCode>>& Runs)
+			{
+				uint64 Bytes = 0;
+				for (const TArray<FMortonCode>& Run : Runs) Bytes += Run.GetAllocatedSize();
+				return Bytes;
+			};
+
+			TArray<TArray<FMortonCode>> Runs = MakeRuns();
+			const uint64 InputBytes = GetBytes(Runs);
+			TArray<FMortonCode> Merged;
+			uint64 MergePeakBytes = 0;
+
+			const double MergeSeconds = TimeSecondsAndPeakBytes([&]()
+			{
+				Merged = NavVolume::Sort::MergeUnique(MoveTemp(Runs));
+			}, MergePeakBytes);
+
+			// Only a hash of the result is kept so it doesn't weigh on the other side
+			const int32 NumMerged = Merged.Num();
+			const FXxHash64 MergedHash = FXxHash64::HashBuffer(Merged.GetData(), Merged.Num() * sizeof(FMortonCode));
+			Merged.Empty();
+
+			Runs = MakeRuns();
+			TArray<FMortonCode> Sorted;
+			uint64 SortPeakBytes = 0;
+
+			const double SortSeconds = TimeSecondsAndPeakBytes([&]()
+			{
+				for (const TArray<FMortonCode>& Run : Runs) Sorted.Append(Run);
+				Runs.Empty();
+				SortUniqueReference(Sorted);
+			}, SortPeakBytes);
+
+			Checks.Check(Sorted.Num() == NumMerged && FXxHash64::HashBuffer(Sorted.GetData(), Sorted.Num() * sizeof(FMortonCode)) == MergedHash,
+				FString::Printf(TEXT("MergeRuns.%d"), NumCodes));
+			Sorted.Empty();
+
+			AddResult(Results, FString::Printf(TEXT("MergeRuns.%d"), NumCodes), NumCodes, MergeSeconds);
+			AddResult(Results, FString::Printf(TEXT("AppendSortUnique.%d"), NumCodes), NumCodes, SortSeconds);
+
+			const TSharedPtr<FJsonObject> Entry = MakeShared<FJsonObject>();
+			Entry->SetNumberField(TEXT("codes"), NumCodes);
+			Entry->SetNumberField(TEXT("runs"), NumRuns);
+			Entry->SetNumberField(TEXT("uniqueCodes"), NumMerged);
+			Entry->SetNumberField(TEXT("mergeSeconds"), MergeSeconds);
+			Entry->SetNumberField(TEXT("mergePeakBytes"), static_cast<double>(InputBytes + MergePeakBytes));
+			Entry->SetNumberField(TEXT("appendSortSeconds"), SortSeconds);
+			Entry->SetNumberField(TEXT("appendSortPeakBytes"), static_cast<double>(InputBytes + SortPeakBytes));
+			Merges.Add(MakeShared<FJsonValueObject>(Entry));
+		}
+
+		return Merges;
+	}
+
+	/** Half the edge of a cube around the origin of a shape's local space that contains the shape. */
+	double GetLocalExtent(const FKSphereElem& Elem) { return Elem.Radius; }
+	double GetLocalExtent(const FKBoxElem& Elem) { return 0.5 * FMath::Max3(Elem.X, Elem.Y, Elem.Z); }
+	double GetLocalExtent(const FKSphylElem& Elem) { return Elem.Radius + 0.5 * Elem.Length; }
+	double GetLocalExtent(const FKConvexElem& Elem) { return FMath::Max(Elem.ElemBox.Min.GetAbsMax(), Elem.ElemBox.Max.GetAbsMax()); }
+
+	/** Compares IsInside4 with IsInside at random positions around every shape of a type. Lanes are single precision, so a position
+	 *	within float precision of the surface may differ - a few per hundred thousand are tolerated, a wrong lane or mask never is.
+	 */
+	template<int32 VoxelSize, typename ShapeType>
+	void CheckShapeTest(const TArray<ShapeType>& Elems, const TCHAR* Name, FRandomStream& Random, FBenchmarkChecks& Checks)
+	{
+		constexpr int32 NumSamples = 1 << 12;
+		int64 NumTested = 0;
+		int64 NumDiffer = 0;
+
+		for (const ShapeType& Elem : Elems)
+		{
+			const NavVolume::Voxel::TShapeTest<VoxelSize, ShapeType> ShapeTest(Elem);
+			const float Extent = GetLocalExtent(Elem) + VoxelSize;
+
+			for (int32 Sample = 0; Sample < NumSamples; Sample += 4)
+			{
+				float X[4], Y[4], Z[4];
+				int32 ScalarMask = 0;
+
+				for (int32 Lane = 0; Lane < 4; ++Lane)
+				{
+					X[Lane] = Random.FRandRange(-Extent, Extent);
+					Y[Lane] = Random.FRandRange(-Extent, Extent);
+					Z[Lane] = Random.FRandRange(-Extent, Extent);
+					ScalarMask |= ShapeTest.IsInside(FVector(X[Lane], Y[Lane], Z[Lane])) ? 1 << Lane : 0;
+				}
+
+				const int32 Mask = ShapeTest.IsInside4(MakeVectorRegisterFloat(X[0], X[1], X[2], X[3]), MakeVectorRegisterFloat(Y[0], Y[1], Y[2], Y[3]),
+					MakeVectorRegisterFloat(Z[0], Z[1], Z[2], Z[3]));
+				NumDiffer += FMath::CountBits(static_cast<uint64>(Mask ^ ScalarMask));
+				NumTested += 4;
+			}
+		}
+
+		Checks.Check(NumDiffer * 100000 <= NumTested, FString::Printf(TEXT("IsInside4.%s"), Name));
+	}
+
+	/** Builds octrees of seeded scenes far above MinParallelLevelNum serially and in chunks - the chunked build has to produce the same
+	 *	nodes, solids and leaves. Each scene is sparse voxels, filled cubes that collapse into solid nodes and solid blocks of every size.
+	 */
+	template<int32 VoxelSize>
+	TArray<TSharedPtr<FJsonValue>> CheckOctreeBuild(const FBenchmarkSettings& Settings, TArray<TSharedPtr<FJsonValue>>& Results, FBenchmarkChecks& Checks)
+	{
+		using NavVolume::Morton::FMortonCode;
+		using FOctree = NavVolume::Octree::TSparseVoxelOctree<VoxelSize, UNavVolumeSubsystem::OctreeLayout>;
+
+		TArray<TSharedPtr<FJsonValue>> Scaling;
+		const int32 NumWorkers = FTaskGraphInterface::Get().GetNumWorkerThreads();
+
+		for (const int32 Scale : { 5, 7 })
+		{
+			FRandomStream Random(Settings.Seed + Scale);
+			const int32 NumCodes = FOctree::MinParallelLevelNum << Scale;
+			const int32 Log2Range = FMath::CeilLogTwo(NumCodes) + 5;
+			NavVolume::Octree::FOctreeCodes Codes;
+
+			for (int32 Index = 0; Index < NumCodes; ++Index)
+			{
+				Codes.Leaves.Add(RandCode(Random, 0, Log2Range));
+			}
+
+			// Cubes of 32 voxels per axis are 8^5 consecutive codes
+			for (int32 Cube = 0; Cube < 16; ++Cube)
+			{
+				const FMortonCode Base = RandCode(Random, 0, Log2Range) & ~((FMortonCode(1) << 15) - 1);
+				for (FMortonCode Code = Base; Code < Base + (FMortonCode(1) << 15); ++Code) Codes.Leaves.Add(Code);
+			}
+
+			SortUniqueReference(Codes.Leaves);
+			Codes.Solids.SetNum(5);
+
+			for (int32 Level = 0; Level < Codes.Solids.Num(); ++Level)
+			{
+				for (int32 Index = 0; Index < 256; ++Index)
+				{
+					Codes.Solids[Level].Add(RandCode(Random, 0, Log2Range - 3 * (Level + 1)));
+				}
+
+				SortUniqueReference(Codes.Solids[Level]);
+			}
+
+			TUniquePtr<FOctree> Serial;
+			TUniquePtr<FOctree> Chunked;
+			const int32 NumLeafCodes = Codes.Leaves.Num();
+			const double SerialSeconds = TimeSeconds([&]() { Serial = MakeUnique<FOctree>(CopyTemp(Codes), true, 0, false); });
+			const double ChunkedSeconds = TimeSeconds([&]() { Chunked = MakeUnique<FOctree>(MoveTemp(Codes), true); });
+
+			AddResult(Results, FString::Printf(TEXT("BuildOctree.Serial.%d"), NumLeafCodes), NumLeafCodes, SerialSeconds);
+			AddResult(Results, FString::Printf(TEXT("BuildOctree.Chunked.%d"), NumLeafCodes), NumLeafCodes, ChunkedSeconds);
+
+			const bool bSame = Serial->LevelOffsets == Chunked->LevelOffsets && Serial->FirstChildIndices == Chunked->FirstChildIndices
+				&& Serial->ChildBitMasks == Chunked->ChildBitMasks && Serial->SolidOffsets == Chunked->SolidOffsets && Serial->Solids == Chunked->Solids
+				&& Serial->Leaves == Chunked->Leaves && Serial->Bricks == Chunked->Bricks;
+
+			// A scene that doesn't reach two chunks at the leaves compares nothing
+			Checks.Check(bSame && Serial->Leaves.Num() >= 2 * FOctree::MinParallelLevelNum, FString::Printf(TEXT("BuildOctree.Chunked.%d"), NumLeafCodes));
+
+			const TSharedPtr<FJsonObject> Entry = MakeShared<FJsonObject>();
+			Entry->SetNumberField(TEXT("codes"), NumLeafCodes);
+			Entry->SetNumberField(TEXT("leaves"), Serial->Leaves.Num());
+			Entry->SetNumberField(TEXT("workers"), NumWorkers);
+			Entry->SetNumberField(TEXT("serialSeconds"), SerialSeconds);
+			Entry->SetNumberField(TEXT("chunkedSeconds"), ChunkedSeconds);
+			Entry->SetNumberField(TEXT("speedup"), ChunkedSeconds > 0.0 ? SerialSeconds / ChunkedSeconds : 0.0);
+			Scaling.Add(MakeShared<FJsonValueObject>(Entry));
+		}
+
+		return Scaling;
+	}
+
+	/** Random shapes of every type scattered over the scene, between a few voxels and an eighth of the scene across. */
+	FKAggregateGeom MakeScene(const FBenchmarkSettings& Settings)
+	{
+		FRandomStream Random(Settings.Seed);
+		FKAggregateGeom Scene;
+
+		const double SceneSize = static_cast<double>(Settings.VoxelSize << Settings.SceneLog2Size);
+		const double MaxShapeSize = SceneSize / 8.0;
+		const double MinShapeSize = Settings.VoxelSize * 4.0;
+
+		const auto RandomSize = [&]() { return Random.FRandRange(MinShapeSize, MaxShapeSize); };
+		const auto RandomCenter = [&]() { return FVector(Random.FRandRange(0.0, SceneSize), Random.FRandRange(0.0, SceneSize), Random.FRandRange(0.0, SceneSize)); };
+		const auto RandomRotation = [&]() { return FRotator(Random.FRandRange(-180.0, 180.0), Random.FRandRange(-180.0, 180.0), Random.FRandRange(-180.0, 180.0)); };
+
+		for (int32 Index = 0; Index < Settings.NumShapes; ++Index)
+		{
+			FKBoxElem& Box = Scene.BoxElems.Add_GetRef(FKBoxElem(RandomSize(), RandomSize(), RandomSize()));
+			Box.Center = RandomCenter();
+			Box.Rotation = RandomRotation();
+
+			FKSphereElem& Sphere = Scene.SphereElems.Add_GetRef(FKSphereElem(RandomSize() * 0.5));
+			Sphere.Center = RandomCenter();
+
+			FKSphylElem& Sphyl = Scene.SphylElems.Add_GetRef(FKSphylElem(RandomSize() * 0.25, RandomSize()));
+			Sphyl.Center = RandomCenter();
+			Sphyl.Rotation = RandomRotation();
+
+			// A random hull of a dozen points - the planes the voxelizer tests come from the Chaos convex
+			const FVector Center = RandomCenter();
+			const double Radius = RandomSize() * 0.5;
+			TArray<Chaos::FConvex::FVec3Type> HullVertices;
+			FKConvexElem& Convex = Scene.ConvexElems.AddDefaulted_GetRef();
+
+			for (int32 Vertex = 0; Vertex < 12; ++Vertex)
+			{
+				const FVector Position = Center + Random.GetUnitVector() * Radius;
+				Convex.VertexData.Add(Position);
+				HullVertices.Emplace(Position);
+			}
+
+			Convex.UpdateElemBox();
+			Convex.SetConvexMeshObject(Chaos::FConvexPtr(new Chaos::FConvex(HullVertices, 0.0f)));
+		}
+
+		return Scene;
+	}
+
+	/** Random triangles scattered over the scene, the same sizes as the shapes. */
+	TArray<FVector> MakeTriangles(const FBenchmarkSettings& Settings)
+	{
+		FRandomStream Random(Settings.Seed + 1);
+		TArray<FVector> Vertices;
+
+		const double SceneSize = static_cast<double>(Settings.VoxelSize << Settings.SceneLog2Size);
+		const double MaxShapeSize = SceneSize / 8.0;
+
+		for (int32 Index = 0; Index < Settings.NumShapes; ++Index)
+		{
+			const FVector Center(Random.FRandRange(0.0, SceneSize), Random.FRandRange(0.0, SceneSize), Random.FRandRange(0.0, SceneSize));
+
+			for (int32 Corner = 0; Corner < 3; ++Corner)
+			{
+				Vertices.Add(Center + Random.GetUnitVector() * Random.FRandRange(0.0, MaxShapeSize));
+			}
+		}
+
+		return Vertices;
+	}
+
+	void BenchmarkMorton(const FBenchmarkSettings& Settings, TArray<TSharedPtr<FJsonValue>>& Results)
+	{
+		FRandomStream Random(Settings.Seed);
+		constexpr int32 MaxCoordinate = (1 << 20) - 1;
+
+		TArray<FIntVector> Points;
+		Points.SetNumUninitialized(Settings.NumMortonCodes);
+
+		for (FIntVector& Point : Points)
+		{
+			Point = FIntVector(Random.RandRange(-MaxCoordinate, MaxCoordinate), Random.RandRange(-MaxCoordinate, MaxCoordinate), Random.RandRange(-MaxCoordinate, MaxCoordinate));
+		}
+
+		TArray<NavVolume::Morton::FMortonCode> Codes;
+		Codes.SetNumUninitialized(Points.Num());
+
+		AddResult(Results, TEXT("EncodeMorton"), Points.Num(), TimeSeconds([&]()
+		{
+			for (int32 Index = 0; Index < Points.Num(); ++Index)
+			{
+				Codes[Index] = NavVolume::Morton::EncodeMorton(Points[Index]);
+			}
+		}));
+
+		AddResult(Results, TEXT("EncodeMortonBatch"), Points.Num(), TimeSeconds([&]()
+		{
+			NavVolume::Morton::EncodeMortonBatch(Points, Codes);
+		}));
+
+		AddResult(Results, TEXT("DecodeMortonBatch"), Points.Num(), TimeSeconds([&]()
+		{
+			NavVolume::Morton::DecodeMortonBatch(Codes, Points);
+		}));
+
+		// Every path the CPU runs, not just the one picked for it - a regression of one path shows even on machines that don't use it
+		for (const NavVolume::Morton::EMortonBatchPath Path : MortonBatchPaths)
+		{
+			if (!NavVolume::Morton::IsMortonBatchPathSupported(Path))
+			{
+				continue;
+			}
+			
+			AddResult(Results, FString::Printf(TEXT("EncodeMortonBatch.%s"), GetMortonBatchPathName(Path)), Points.Num(), TimeSeconds([&]()
+			{
+				NavVolume::Morton::EncodeMortonBatch(Path, Points, Codes);
+			}));
+
+			AddResult(Results, FString::Printf(TEXT("DecodeMortonBatch.%s"), GetMortonBatchPathName(Path)), Points.Num(), TimeSeconds([&]()
+			{
+				NavVolume::Morton::DecodeMortonBatch(Path, Codes, Points);
+			}));
+		}
+	}
+
+	/** Round trips every coordinate of the supported range [-2^20, 2^20 - 1] on every axis through every path the CPU supports,
+	 *	comparing the codes with the scalar EncodeMorton. The axes walk the range from different offsets so no two share a value.
+	 */
+	void CheckMorton(FBenchmarkChecks& Checks)
+	{
+		constexpr int32 MinCoordinate = -(1 << 20);
+		constexpr int32 NumCoordinates = 1 << 21;
+
+		TArray<FIntVector> Points;
+		TArray<NavVolume::Morton::FMortonCode> Expected;
+		Points.SetNumUninitialized(NumCoordinates);
+		Expected.SetNumUninitialized(NumCoordinates);
+
+		bool bScalarRoundTrip = true;
+		
+		for (int32 Index = 0; Index < NumCoordinates; ++Index)
+		{
+			const auto Wrap = [Index](const int32 Offset) { return MinCoordinate + (Index + Offset) % NumCoordinates; };
+			Points[Index] = FIntVector(Wrap(0), Wrap(NumCoordinates / 3), Wrap(NumCoordinates * 2 / 3));
+			Expected[Index] = NavVolume::Morton::EncodeMorton(Points[Index]);
+			bScalarRoundTrip &= NavVolume::Morton::DecodeMorton(Expected[Index]) == Points[Index];
+		}
+
+		Checks.Check(bScalarRoundTrip, TEXT("MortonRoundTrip.Scalar"));
+
+		TArray<NavVolume::Morton::FMortonCode> Codes;
+		TArray<FIntVector> Decoded;
+		Codes.SetNumUninitialized(NumCoordinates);
+		Decoded.SetNumUninitialized(NumCoordinates);
+
+		for (const NavVolume::Morton::EMortonBatchPath Path : MortonBatchPaths)
+		{
+			if (!NavVolume::Morton::IsMortonBatchPathSupported(Path))
+			{
+				continue;
+			}
+
+			NavVolume::Morton::EncodeMortonBatch(Path, Points, Codes);
+			NavVolume::Morton::DecodeMortonBatch(Path, Codes, Decoded);
+			Checks.Check(Codes == Expected, FString::Printf(TEXT("MortonEncode.%s"), GetMortonBatchPathName(Path)));
+			Checks.Check(Decoded == Points, FString::Printf(TEXT("MortonDecode.%s"), GetMortonBatchPathName(Path)));
+
+			// A length that isn't a multiple of the vector width covers the scalar tail of the vector paths too
+			constexpr int32 NumTail = 7;
+			NavVolume::Morton::EncodeMortonBatch(Path, MakeArrayView(Points.GetData(), NumTail), MakeArrayView(Codes.GetData(), NumTail));
+			NavVolume::Morton::DecodeMortonBatch(Path, MakeArrayView(Codes.GetData(), NumTail), MakeArrayView(Decoded.GetData(), NumTail));
+			Checks.Check(AreEqual<NavVolume::Morton::FMortonCode>(MakeArrayView(Codes.GetData(), NumTail), MakeArrayView(Expected.GetData(), NumTail))
+				&& AreEqual<FIntVector>(MakeArrayView(Decoded.GetData(), NumTail), MakeArrayView(Points.GetData(), NumTail)),
+				FString::Printf(TEXT("MortonTail.%s"), GetMortonBatchPathName(Path)));
+		}
+	}
+
+	template<int32 VoxelSize>
+	TSharedPtr<FJsonObject> RunBenchmarks(const FBenchmarkSettings& Settings, FBenchmarkChecks& Checks)
+	{
+		TArray<TSharedPtr<FJsonValue>> Results;
+		BenchmarkMorton(Settings, Results);
+		CheckMorton(Checks);
+		CheckSort(Settings, Results, Checks);
+		const TArray<TSharedPtr<FJsonValue>> Merges = BenchmarkMerge(Settings, Results, Checks);
+
+		const FKAggregateGeom Scene = MakeScene(Settings);
+		FRandomStream ShapeRandom(Settings.Seed + 3);
+		CheckShapeTest<VoxelSize>(Scene.SphereElems, TEXT("Sphere"), ShapeRandom, Checks);
+		CheckShapeTest<VoxelSize>(Scene.BoxElems, TEXT("Box"), ShapeRandom, Checks);
+		CheckShapeTest<VoxelSize>(Scene.SphylElems, TEXT("Sphyl"), ShapeRandom, Checks);
+		CheckShapeTest<VoxelSize>(Scene.ConvexElems, TEXT("Convex"), ShapeRandom, Checks);
+
+		const FBox SceneBounds(FVector(-VoxelSize), FVector(static_cast<double>(VoxelSize << Settings.SceneLog2Size) + VoxelSize));
+		TArray<NavVolume::Octree::FOctreeCodes> Runs;
+
+		// Each shape type on its own through the bin voxelizers of a build, run one after another on this thread so the time is the
+		// shape tests and encoding alone - voxels counted include the solid interiors
+		const auto BenchmarkShapes = [&](const TCHAR* Name, const FKAggregateGeom& Shapes)
+		{
+			using namespace NavVolume::BroadPhase;
+			const TSharedPtr<FShapeSet> ShapeSet = MakeShared<FShapeSet>();
+			ShapeSet->AddComponent(FTransform::Identity, SceneBounds, Shapes);
+
+			TArray<NavVolume::Octree::FOctreeCodes> ShapeRuns;
+			const double Seconds = TimeSeconds([&]()
+			{
+				for (const TBinVoxelizer<VoxelSize>& Voxelizer : MakeBinVoxelizers<VoxelSize>(ShapeSet, BinShapes<VoxelSize>(*ShapeSet), 1, true, nullptr))
+				{
+					ShapeRuns.Add(Voxelizer());
+				}
+			});
+
+			NavVolume::Octree::FOctreeCodes Codes = NavVolume::Octree::FOctreeCodes::Merge(MoveTemp(ShapeRuns));
+			AddResult(Results, Name, CountVoxels(Codes), Seconds);
+			Runs.Add(MoveTemp(Codes));
+		};
+
+		const auto BenchmarkShapeType = [&](const TCHAR* Name, const auto Elems)
+		{
+			FKAggregateGeom Shapes;
+			Shapes.*Elems = Scene.*Elems;
+			BenchmarkShapes(Name, Shapes);
+		};
+
+		BenchmarkShapeType(TEXT("VoxelizeBox"), &FKAggregateGeom::BoxElems);
+		BenchmarkShapeType(TEXT("VoxelizeSphere"), &FKAggregateGeom::SphereElems);
+		BenchmarkShapeType(TEXT("VoxelizeSphyl"), &FKAggregateGeom::SphylElems);
+		BenchmarkShapeType(TEXT("VoxelizeConvex"), &FKAggregateGeom::ConvexElems);
+
+		const TArray<FVector> Triangles = MakeTriangles(Settings);
+		TArray<NavVolume::Morton::FMortonCode> TriangleCodes;
+
+		const double TriangleSeconds = TimeSeconds([&]()
+		{
+			for (int32 Index = 0; Index < Triangles.Num(); Index += 3)
+			{
+				// Clipped to the scene like the triangles of a component
+				const FBox TriangleBounds = FBox(&Triangles[Index], 3).Overlap(SceneBounds);
+				if (!TriangleBounds.IsValid) continue;
+
+				FIntVector VoxelMin, VoxelMax;
+				NavVolume::Voxel::GetVoxelRange<VoxelSize>(TriangleBounds, VoxelMin, VoxelMax);
+				NavVolume::Voxel::VoxelizeTriangle<VoxelSize>(Triangles[Index], Triangles[Index + 1], Triangles[Index + 2], VoxelMin, VoxelMax,
+					[&TriangleCodes](const FIntVector& WorldPosition) { TriangleCodes.Add(NavVolume::Morton::EncodeMorton(NavVolume::Voxel::QuantizeVoxel<VoxelSize>(WorldPosition))); },
+					[](const FIntVector&, const int32) { return false; });
+			}
+		});
+
+		AddResult(Results, TEXT("VoxelizeTriangle"), TriangleCodes.Num(), TriangleSeconds);
+		NavVolume::Sort::SortUnique(TriangleCodes);
+		Runs.Add(NavVolume::Octree::FOctreeCodes { MoveTemp(TriangleCodes) });
+
+		// The octree of the whole scene with the layout the subsystem builds
+		using FOctree = NavVolume::Octree::TSparseVoxelOctree<VoxelSize, UNavVolumeSubsystem::OctreeLayout>;
+
+		NavVolume::Octree::FOctreeCodes Codes = NavVolume::Octree::FOctreeCodes::Merge(MoveTemp(Runs));
+		const int32 NumLeafCodes = Codes.Leaves.Num();
+
+		// The same scene through the production build, against the per shape codes above
+		FRandomStream Random(Settings.Seed);
+		const TSharedPtr<FJsonObject> Pipeline = BenchmarkPipeline<VoxelSize>(Scene, Triangles, SceneBounds, Codes, Random, Results, Checks);
+
+		// Growing the leaves for an agent two voxels wide, as each agent profile does per tile
+		TArray<NavVolume::Morton::FMortonCode> DilatedLeaves = Codes.Leaves;
+
+		const double DilateSeconds = TimeSeconds([&]()
+		{
+			NavVolume::Octree::FOctreeCodes::DilateLeaves(DilatedLeaves, 2);
+		});
+
+		AddResult(Results, TEXT("DilateLeaves"), DilatedLeaves.Num(), DilateSeconds);
+		TUniquePtr<FOctree> Octree;
+
+		const double BuildSeconds = TimeSeconds([&]()
+		{
+			Octree = MakeUnique<FOctree>(MoveTemp(Codes), true);
+		});
+
+		int64 NumNodes = Octree->Leaves.Num();
+		SIZE_T AllocatedSize = Octree->GetLeafAllocatedSize();
+
+		for (int32 Level = 0; Level < Octree->NumLevels(); ++Level)
+		{
+			NumNodes += Octree->NumNodes(Level);
+			AllocatedSize += Octree->GetLevelAllocatedSize(Level);
+		}
+
+		AddResult(Results, TEXT("BuildOctree"), NumNodes, BuildSeconds);
+		const TArray<TSharedPtr<FJsonValue>> OctreeScaling = CheckOctreeBuild<VoxelSize>(Settings, Results, Checks);
+
+		const TSharedPtr<FJsonObject> Report = MakeShared<FJsonObject>();
+		Report->SetNumberField(TEXT("seed"), Settings.Seed);
+		Report->SetNumberField(TEXT("shapes"), Settings.NumShapes);
+		Report->SetNumberField(TEXT("voxelSize"), VoxelSize);
+		Report->SetArrayField(TEXT("results"), Results);
+		Report->SetObjectField(TEXT("pipeline"), Pipeline);
+		Report->SetArrayField(TEXT("octreeScaling"), OctreeScaling);
+		Report->SetArrayField(TEXT("merge"), Merges);
+		Report->SetNumberField(TEXT("octreeNodes"), static_cast<double>(NumNodes));
+		Report->SetNumberField(TEXT("octreeBytes"), static_cast<double>(AllocatedSize));
+		Report->SetNumberField(TEXT("octreeBytesPerLeaf"), static_cast<double>(AllocatedSize) / FMath::Max(1, NumLeafCodes));
+		return Report;
+	}
+}
+
+UNavVolumeBenchmarkCommandlet::UNavVolumeBenchmarkCommandlet()
+{
+	IsClient = false;
+	IsEditor = false;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UNavVolumeBenchmarkCommandlet::Main(const FString& Params)
+{
+	FBenchmarkSettings Settings;
+	FParse::Value(*Params, TEXT("Seed="), Settings.Seed);
+	FParse::Value(*Params, TEXT("Shapes="), Settings.NumShapes);
+	FParse::Value(*Params, TEXT("VoxelSize="), Settings.VoxelSize);
+
+	if (FString MergeCodes; FParse::Value(*Params, TEXT("MergeCodes="), MergeCodes, false))
+	{
+		TArray<FString> Sizes;
+		MergeCodes.ParseIntoArray(Sizes, TEXT(","));
+		Settings.MergeSizes.Reset();
+
+		for (const FString& Size : Sizes)
+		{
+			if (const int32 NumCodes = FCString::Atoi(*Size); NumCodes > 0) Settings.MergeSizes.Add(NumCodes);
+		}
+	}
+
+	FString OutputFilename = FPaths::ProjectSavedDir() / TEXT("NavVolume") / TEXT("Benchmark.json");
+	FParse::Value(*Params, TEXT("Output="), OutputFilename);
+
+	if (!NavVolume::Voxel::IsSupportedVoxelSize(Settings.VoxelSize))
+	{
+		UE_LOG(LogTemp, Error, TEXT("NavVolumeBenchmark: unsupported voxel size %d"), Settings.VoxelSize);
+		return 1;
+	}
+
+	FBenchmarkChecks Checks;
+	const TSharedPtr<FJsonObject> Report = NavVolume::Voxel::DispatchVoxelSize(Settings.VoxelSize, [&Settings, &Checks](auto VoxelSize)
+	{
+		return RunBenchmarks<decltype(VoxelSize)::Value>(Settings, Checks);
+	});
+
+	TArray<TSharedPtr<FJsonValue>> Failures;
+
+	for (const FString& Failure : Checks.Failures)
+	{
+		Failures.Add(MakeShared<FJsonValueString>(Failure));
+	}
+
+	Report->SetArrayField(TEXT("failedChecks"), Failures);
+	Report->SetStringField(TEXT("morton"), GetMortonBatchPathName(NavVolume::Morton::GetMortonBatchPath()));
+	Report->SetStringField(TEXT("engineVersion"), FEngineVersion::Current().ToString());
+	Report->SetNumberField(TEXT("peakUsedPhysicalBytes"), static_cast<double>(FPlatformMemory::GetStats().PeakUsedPhysical));
+
+	FString Json;
+	const TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Json);
+	FJsonSerializer::Serialize(Report.ToSharedRef(), Writer);
+
+	if (!FFileHelper::SaveStringToFile(Json, *OutputFilename))
+	{
+		UE_LOG(LogTemp, Error, TEXT("NavVolumeBenchmark: failed to write %s"), *OutputFilename);
+		return 1;
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("NavVolumeBenchmark: results written to %s"), *OutputFilename);
+
+	if (!Checks.Failures.IsEmpty())
+	{
+		UE_LOG(LogTemp, Error, TEXT("NavVolumeBenchmark: %d checks failed"), Checks.Failures.Num());
+		return 1;
+	}
+
+	return 0;
+}
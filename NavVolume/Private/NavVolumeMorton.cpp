@@ -1,5 +1,19 @@
 #include "NavVolumeMorton.h"
 
+#if PLATFORM_CPU_X86_FAMILY
+	#include <immintrin.h>
+	#if defined(_MSC_VER)
+		#include <intrin.h>
+	#else
+		#include <cpuid.h>
+	#endif
+	#if defined(__clang__) || defined(__GNUC__)
+		#define NAVVOLUME_TARGET(Features) __attribute__((target(Features)))
+	#else
+		#define NAVVOLUME_TARGET(Features) // MSVC allows intrinsics without enabling the instruction set
+	#endif
+#endif
+
 // Anonymous - content shouldn't be needed outside this file.
 namespace
 {
@@ -46,6 +60,240 @@ namespace
 	{
 		return static_cast<int32>(N) - SignOffset;
 	}
+
+	/** Every third bit starting at X, Y and Z respectively - the deposit/extract masks for PDEP and PEXT. */
+	constexpr uint64 MaskX = 0x1249249249249249;
+	constexpr uint64 MaskY = MaskX << 1;
+	constexpr uint64 MaskZ = MaskX << 2;
+
+	using FEncodeBatchFunc = void(*)(const FIntVector*, NavVolume::Morton::FMortonCode*, int32);
+	using FDecodeBatchFunc = void(*)(const NavVolume::Morton::FMortonCode*, FIntVector*, int32);
+
+	void EncodeBatchScalar(const FIntVector* Points, NavVolume::Morton::FMortonCode* Codes, const int32 Num)
+	{
+		for (int32 Index = 0; Index < Num; ++Index)
+		{
+			Codes[Index] = Part(Normalize(Points[Index].X)) << 0 |
+						   Part(Normalize(Points[Index].Y)) << 1 |
+						   Part(Normalize(Points[Index].Z)) << 2 ;
+		}
+	}
+
+	void DecodeBatchScalar(const NavVolume::Morton::FMortonCode* Codes, FIntVector* Points, const int32 Num)
+	{
+		for (int32 Index = 0; Index < Num; ++Index)
+		{
+			Points[Index] = FIntVector(
+				Denormalize(Compact(Codes[Index] >> 0)),
+				Denormalize(Compact(Codes[Index] >> 1)),
+				Denormalize(Compact(Codes[Index] >> 2))
+			);
+		}
+	}
+
+#if PLATFORM_CPU_X86_FAMILY
+	/** CPUID leaf 7 (sub-leaf 0) EBX - bit 5 is AVX2 and bit 8 is BMI2. */
+	void GetCpuidLeaf7(uint32& OutEbx)
+	{
+#if defined(_MSC_VER)
+		int32 Registers[4];
+		__cpuidex(Registers, 7, 0);
+		OutEbx = static_cast<uint32>(Registers[1]);
+#else
+		uint32 Eax, Ebx, Ecx, Edx;
+		OutEbx = __get_cpuid_count(7, 0, &Eax, &Ebx, &Ecx, &Edx) ? Ebx : 0;
+#endif
+	}
+
+	bool HasBMI2()
+	{
+		uint32 Ebx;
+		GetCpuidLeaf7(Ebx);
+		return (Ebx & (1 << 8)) != 0;
+	}
+
+	/** PDEP and PEXT are single uops on Intel and on AMD from Zen 3 (family 19h), but microcoded with data dependent latency before it. */
+	bool HasFastBMI2()
+	{
+		if (!HasBMI2())
+		{
+			return false;
+		}
+		
+		uint32 Vendor[3];
+		uint32 Signature;
+#if defined(_MSC_VER)
+		int32 Registers[4];
+		__cpuid(Registers, 0);
+		Vendor[0] = static_cast<uint32>(Registers[1]);
+		Vendor[1] = static_cast<uint32>(Registers[3]);
+		Vendor[2] = static_cast<uint32>(Registers[2]);
+		__cpuid(Registers, 1);
+		Signature = static_cast<uint32>(Registers[0]);
+#else
+		uint32 MaxLeaf, Unused;
+		__get_cpuid(0, &MaxLeaf, &Vendor[0], &Vendor[2], &Vendor[1]);
+		__get_cpuid(1, &Signature, &Unused, &Unused, &Unused);
+#endif
+
+		const bool bAMD = FMemory::Memcmp(Vendor, "AuthenticAMD", sizeof(Vendor)) == 0;
+		const uint32 Family = ((Signature >> 8) & 0xf) == 0xf ? 0xf + ((Signature >> 20) & 0xff) : (Signature >> 8) & 0xf;
+		return !bAMD || Family >= 0x19;
+	}
+
+	/** AVX2 also needs the OS to save the YMM registers - checked through OSXSAVE and XCR0. */
+	bool HasAVX2()
+	{
+		uint32 Ebx;
+		GetCpuidLeaf7(Ebx);
+
+#if defined(_MSC_VER)
+		int32 Registers[4];
+		__cpuid(Registers, 1);
+		const bool bOSXSave = (Registers[2] & (1 << 27)) != 0;
+		const uint64 XCR0 = bOSXSave ? _xgetbv(0) : 0;
+#else
+		uint32 Eax, Ebx1, Ecx, Edx;
+		const bool bOSXSave = __get_cpuid(1, &Eax, &Ebx1, &Ecx, &Edx) && (Ecx & (1 << 27)) != 0;
+		uint32 XCR0Low = 0, XCR0High = 0;
+		if (bOSXSave)
+		{
+			__asm__ volatile("xgetbv" : "=a"(XCR0Low), "=d"(XCR0High) : "c"(0));
+		}
+		const uint64 XCR0 = static_cast<uint64>(XCR0High) << 32 | XCR0Low;
+#endif
+
+		return (Ebx & (1 << 5)) != 0 && (XCR0 & 0x6) == 0x6;
+	}
+
+	NAVVOLUME_TARGET("bmi2")
+	void EncodeBatchBMI2(const FIntVector* Points, NavVolume::Morton::FMortonCode* Codes, const int32 Num)
+	{
+		for (int32 Index = 0; Index < Num; ++Index)
+		{
+			Codes[Index] = _pdep_u64(Normalize(Points[Index].X), MaskX) |
+						   _pdep_u64(Normalize(Points[Index].Y), MaskY) |
+						   _pdep_u64(Normalize(Points[Index].Z), MaskZ) ;
+		}
+	}
+
+	NAVVOLUME_TARGET("bmi2")
+	void DecodeBatchBMI2(const NavVolume::Morton::FMortonCode* Codes, FIntVector* Points, const int32 Num)
+	{
+		for (int32 Index = 0; Index < Num; ++Index)
+		{
+			Points[Index] = FIntVector(
+				Denormalize(static_cast<uint32>(_pext_u64(Codes[Index], MaskX))),
+				Denormalize(static_cast<uint32>(_pext_u64(Codes[Index], MaskY))),
+				Denormalize(static_cast<uint32>(_pext_u64(Codes[Index], MaskZ)))
+			);
+		}
+	}
+
+	/** Part() on four 64-bit lanes. */
+	NAVVOLUME_TARGET("avx2")
+	__m256i Part4(__m256i N)
+	{
+		N = _mm256_and_si256(N, _mm256_set1_epi64x(0x1fffff));
+		N = _mm256_and_si256(_mm256_xor_si256(N, _mm256_slli_epi64(N, 32)), _mm256_set1_epi64x(0x1f00000000ffff));
+		N = _mm256_and_si256(_mm256_xor_si256(N, _mm256_slli_epi64(N, 16)), _mm256_set1_epi64x(0x1f0000ff0000ff));
+		N = _mm256_and_si256(_mm256_xor_si256(N, _mm256_slli_epi64(N,  8)), _mm256_set1_epi64x(0x100f00f00f00f00f));
+		N = _mm256_and_si256(_mm256_xor_si256(N, _mm256_slli_epi64(N,  4)), _mm256_set1_epi64x(0x10c30c30c30c30c3));
+		N = _mm256_and_si256(_mm256_xor_si256(N, _mm256_slli_epi64(N,  2)), _mm256_set1_epi64x(0x1249249249249249));
+		return N;
+	}
+
+	/** Compact() on four 64-bit lanes. */
+	NAVVOLUME_TARGET("avx2")
+	__m256i Compact4(__m256i N)
+	{
+		N = _mm256_and_si256(N, _mm256_set1_epi64x(0x1249249249249249));
+		N = _mm256_and_si256(_mm256_xor_si256(N, _mm256_srli_epi64(N,  2)), _mm256_set1_epi64x(0x10c30c30c30c30c3));
+		N = _mm256_and_si256(_mm256_xor_si256(N, _mm256_srli_epi64(N,  4)), _mm256_set1_epi64x(0x100f00f00f00f00f));
+		N = _mm256_and_si256(_mm256_xor_si256(N, _mm256_srli_epi64(N,  8)), _mm256_set1_epi64x(0x1f0000ff0000ff));
+		N = _mm256_and_si256(_mm256_xor_si256(N, _mm256_srli_epi64(N, 16)), _mm256_set1_epi64x(0x1f00000000ffff));
+		N = _mm256_and_si256(_mm256_xor_si256(N, _mm256_srli_epi64(N, 32)), _mm256_set1_epi64x(0x1fffff));
+		return N;
+	}
+
+	NAVVOLUME_TARGET("avx2")
+	void EncodeBatchAVX2(const FIntVector* Points, NavVolume::Morton::FMortonCode* Codes, const int32 Num)
+	{
+		const int32 NumVectorized = Num & ~3;
+
+		for (int32 Index = 0; Index < NumVectorized; Index += 4)
+		{
+			const FIntVector* P = Points + Index;
+			const __m256i X = _mm256_set_epi64x(Normalize(P[3].X), Normalize(P[2].X), Normalize(P[1].X), Normalize(P[0].X));
+			const __m256i Y = _mm256_set_epi64x(Normalize(P[3].Y), Normalize(P[2].Y), Normalize(P[1].Y), Normalize(P[0].Y));
+			const __m256i Z = _mm256_set_epi64x(Normalize(P[3].Z), Normalize(P[2].Z), Normalize(P[1].Z), Normalize(P[0].Z));
+
+			const __m256i Code = _mm256_or_si256(_mm256_or_si256(Part4(X), _mm256_slli_epi64(Part4(Y), 1)), _mm256_slli_epi64(Part4(Z), 2));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(Codes + Index), Code);
+		}
+
+		EncodeBatchScalar(Points + NumVectorized, Codes + NumVectorized, Num - NumVectorized);
+	}
+
+	NAVVOLUME_TARGET("avx2")
+	void DecodeBatchAVX2(const NavVolume::Morton::FMortonCode* Codes, FIntVector* Points, const int32 Num)
+	{
+		const int32 NumVectorized = Num & ~3;
+		alignas(32) uint64 X[4], Y[4], Z[4];
+
+		for (int32 Index = 0; Index < NumVectorized; Index += 4)
+		{
+			const __m256i Code = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(Codes + Index));
+			_mm256_store_si256(reinterpret_cast<__m256i*>(X), Compact4(Code));
+			_mm256_store_si256(reinterpret_cast<__m256i*>(Y), Compact4(_mm256_srli_epi64(Code, 1)));
+			_mm256_store_si256(reinterpret_cast<__m256i*>(Z), Compact4(_mm256_srli_epi64(Code, 2)));
+
+			for (int32 Lane = 0; Lane < 4; ++Lane)
+			{
+				Points[Index + Lane] = FIntVector(
+					Denormalize(static_cast<uint32>(X[Lane])),
+					Denormalize(static_cast<uint32>(Y[Lane])),
+					Denormalize(static_cast<uint32>(Z[Lane]))
+				);
+			}
+		}
+
+		DecodeBatchScalar(Codes + NumVectorized, Points + NumVectorized, Num - NumVectorized);
+	}
+#endif // PLATFORM_CPU_X86_FAMILY
+
+	FEncodeBatchFunc GetEncodeBatch(const NavVolume::Morton::EMortonBatchPath Path)
+	{
+		switch (Path)
+		{
+#if PLATFORM_CPU_X86_FAMILY
+		case NavVolume::Morton::EMortonBatchPath::BMI2: return &EncodeBatchBMI2;
+		case NavVolume::Morton::EMortonBatchPath::AVX2: return &EncodeBatchAVX2;
+#endif
+		default: return &EncodeBatchScalar;
+		}
+	}
+
+	FDecodeBatchFunc GetDecodeBatch(const NavVolume::Morton::EMortonBatchPath Path)
+	{
+		switch (Path)
+		{
+#if PLATFORM_CPU_X86_FAMILY
+		case NavVolume::Morton::EMortonBatchPath::BMI2: return &DecodeBatchBMI2;
+		case NavVolume::Morton::EMortonBatchPath::AVX2: return &DecodeBatchAVX2;
+#endif
+		default: return &DecodeBatchScalar;
+		}
+	}
+
+	NavVolume::Morton::EMortonBatchPath SelectBatchPath()
+	{
+#if PLATFORM_CPU_X86_FAMILY
+		if (HasFastBMI2()) return NavVolume::Morton::EMortonBatchPath::BMI2;
+		if (HasAVX2()) return NavVolume::Morton::EMortonBatchPath::AVX2;
+#endif
+		return NavVolume::Morton::EMortonBatchPath::Scalar;
+	}
 }
 
 NavVolume::Morton::FMortonCode NavVolume::Morton::EncodeMorton(const int32 X, const int32 Y, const int32 Z)
@@ -87,3 +335,67 @@ int32 NavVolume::Morton::DecodeMortonZ(const FMortonCode Code)
 	return Denormalize(Compact(Code >> 2));
 }
 
+bool NavVolume::Morton::StepMorton(const FMortonCode Code, const int32 Axis, const bool bPositive, FMortonCode& OutCode, const int32 NumBits)
+{
+	check(Axis >= 0 && Axis < 3 && NumBits > 0 && NumBits <= 21);
+	
+	// Arithmetic on a single dilated coordinate - filling the gaps with ones lets a carry ripple through to the next bit of the same axis
+	const uint64 AxisMask = (MaskX << Axis) & ((uint64(1) << (3 * NumBits)) - 1);
+	const uint64 AxisBits = Code & AxisMask;
+
+	if (AxisBits == (bPositive ? AxisMask : 0))
+	{
+		return false;
+	}
+
+	const uint64 SteppedBits = bPositive ? ((AxisBits | ~AxisMask) + 1) & AxisMask : (AxisBits - 1) & AxisMask;
+	OutCode = (Code & ~AxisMask) | SteppedBits;
+	return true;
+}
+
+NavVolume::Morton::EMortonBatchPath NavVolume::Morton::GetMortonBatchPath()
+{
+	static const EMortonBatchPath Path = SelectBatchPath();
+	return Path;
+}
+
+bool NavVolume::Morton::IsMortonBatchPathSupported(const EMortonBatchPath Path)
+{
+	switch (Path)
+	{
+#if PLATFORM_CPU_X86_FAMILY
+	case EMortonBatchPath::BMI2: return HasBMI2();
+	case EMortonBatchPath::AVX2: return HasAVX2();
+#endif
+	case EMortonBatchPath::Scalar: return true;
+	default: return false;
+	}
+}
+
+void NavVolume::Morton::EncodeMortonBatch(TArrayView<const FIntVector> Points, TArrayView<FMortonCode> Codes)
+{
+	check(Points.Num() == Codes.Num());
+	
+	static const FEncodeBatchFunc EncodeBatch = GetEncodeBatch(GetMortonBatchPath());
+	EncodeBatch(Points.GetData(), Codes.GetData(), Points.Num());
+}
+
+void NavVolume::Morton::DecodeMortonBatch(TArrayView<const FMortonCode> Codes, TArrayView<FIntVector> Points)
+{
+	check(Points.Num() == Codes.Num());
+	
+	static const FDecodeBatchFunc DecodeBatch = GetDecodeBatch(GetMortonBatchPath());
+	DecodeBatch(Codes.GetData(), Points.GetData(), Codes.Num());
+}
+
+void NavVolume::Morton::EncodeMortonBatch(const EMortonBatchPath Path, TArrayView<const FIntVector> Points, TArrayView<FMortonCode> Codes)
+{
+	check(Points.Num() == Codes.Num() && IsMortonBatchPathSupported(Path));
+	GetEncodeBatch(Path)(Points.GetData(), Codes.GetData(), Points.Num());
+}
+
+void NavVolume::Morton::DecodeMortonBatch(const EMortonBatchPath Path, TArrayView<const FMortonCode> Codes, TArrayView<FIntVector> Points)
+{
+	check(Points.Num() == Codes.Num() && IsMortonBatchPathSupported(Path));
+	GetDecodeBatch(Path)(Codes.GetData(), Points.GetData(), Codes.Num());
+}
@@ -0,0 +1,355 @@
+#include "NavVolumeSort.h"
+#include "Algo/Unique.h"
+#include "Algo/LowerBound.h"
+#include "Async/ParallelFor.h"
+#include "Async/TaskGraphInterfaces.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+
+// Anonymous - content shouldn't be needed outside this file.
+namespace
+{
+	using namespace NavVolume::Morton;
+	
+	/** Below this many codes a merge isn't worth splitting across workers. */
+	constexpr int32 MinParallelMergeNum = 1 << 16;
+
+	/** Below this many codes a radix sort isn't worth splitting across workers. */
+	constexpr int32 MinParallelRadixNum = 1 << 16;
+
+	/** Below this many codes a comparison sort beats clearing and scanning the radix histograms. */
+	constexpr int32 MinRadixSortNum = 1 << 10;
+
+	/** 8-bit digits - the histogram of each chunk fits comfortably in L1. */
+	constexpr int32 RadixBits = 8;
+	constexpr int32 RadixSize = 1 << RadixBits;
+	constexpr FMortonCode RadixMask = RadixSize - 1;
+
+	/** Number of chunks to split Num elements into so each chunk has at least MinChunkNum elements (up to two per worker). */
+	FORCEINLINE int32 GetNumChunks(const int32 Num, const int32 MinChunkNum)
+	{
+		const int32 NumWorkers = FMath::Max(1, FTaskGraphInterface::Get().GetNumWorkerThreads());
+		return FMath::Clamp(Num / MinChunkNum, 1, NumWorkers * 2);
+	}
+
+	/** Standard two-way merge that only writes a code if it differs from the previously written one - returns the number written. */
+	int32 MergeUniqueSerial(const FMortonCode* A, const int32 NumA, const FMortonCode* B, const int32 NumB, FMortonCode* Out)
+	{
+		int32 IndexA = 0;
+		int32 IndexB = 0;
+		int32 NumOut = 0;
+
+		const auto Write = [&](const FMortonCode Code)
+		{
+			if (NumOut == 0 || Out[NumOut - 1] != Code)
+			{
+				Out[NumOut++] = Code;
+			}
+		};
+		
+		while (IndexA < NumA && IndexB < NumB)
+		{
+			Write(B[IndexB] < A[IndexA] ? B[IndexB++] : A[IndexA++]);
+		}
+
+		while (IndexA < NumA) Write(A[IndexA++]);
+		while (IndexB < NumB) Write(B[IndexB++]);
+		
+		return NumOut;
+	}
+}
+
+void NavVolume::Sort::SortUnique(TArray<FMortonCode>& Codes)
+{
+	RadixSortUnique(Codes);
+}
+
+void NavVolume::Sort::RadixSortUnique(TArray<FMortonCode>& Codes)
+{
+	const int32 Num = Codes.Num();
+
+	if (Num < MinRadixSortNum)
+	{
+		Codes.Sort();
+		Codes.SetNum(Algo::Unique(Codes), EAllowShrinking::No);
+		return;
+	}
+
+	// Only arrays large enough to radix sort are traced - the small sorts of every bin would drown the capture
+	TRACE_CPUPROFILER_EVENT_SCOPE(NavVolume::RadixSortUnique);
+
+	const int32 NumChunks = GetNumChunks(Num, MinParallelRadixNum);
+	const int32 ChunkSize = FMath::DivideAndRoundUp(Num, NumChunks);
+
+	const auto ChunkBegin = [&](const int32 Chunk) { return FMath::Min(Chunk * ChunkSize, Num); };
+	const auto ChunkEnd = [&](const int32 Chunk) { return FMath::Min((Chunk + 1) * ChunkSize, Num); };
+
+	// A bit that is the same in every key can't change the order - a digit made only of such bits would be a pass that just copies.
+	// Voxels of a small area share most of their high bits so this usually removes several passes.
+	TArray<FMortonCode, TInlineAllocator<64>> ChunkAnd;
+	TArray<FMortonCode, TInlineAllocator<64>> ChunkOr;
+	ChunkAnd.SetNumUninitialized(NumChunks);
+	ChunkOr.SetNumUninitialized(NumChunks);
+
+	ParallelFor(NumChunks, [&](const int32 Chunk)
+	{
+		FMortonCode And = ~FMortonCode(0);
+		FMortonCode Or = 0;
+
+		for (int32 Index = ChunkBegin(Chunk); Index < ChunkEnd(Chunk); ++Index)
+		{
+			And &= Codes[Index];
+			Or |= Codes[Index];
+		}
+
+		ChunkAnd[Chunk] = And;
+		ChunkOr[Chunk] = Or;
+	});
+
+	FMortonCode And = ~FMortonCode(0);
+	FMortonCode Or = 0;
+
+	for (int32 Chunk = 0; Chunk < NumChunks; ++Chunk)
+	{
+		And &= ChunkAnd[Chunk];
+		Or |= ChunkOr[Chunk];
+	}
+
+	const FMortonCode VaryingBits = And ^ Or;
+
+	TArray<FMortonCode> Scratch;
+	Scratch.SetNumUninitialized(Num);
+
+	FMortonCode* Src = Codes.GetData();
+	FMortonCode* Dst = Scratch.GetData();
+
+	// One histogram per chunk - rebuilt every pass as the order within each chunk changes
+	TArray<int32> Histograms;
+	Histograms.SetNumUninitialized(NumChunks * RadixSize);
+
+	for (int32 Shift = 0; Shift < 64; Shift += RadixBits)
+	{
+		if (((VaryingBits >> Shift) & RadixMask) == 0)
+		{
+			continue;
+		}
+
+		ParallelFor(NumChunks, [&](const int32 Chunk)
+		{
+			int32* Histogram = Histograms.GetData() + Chunk * RadixSize;
+			FMemory::Memzero(Histogram, RadixSize * sizeof(int32));
+
+			for (int32 Index = ChunkBegin(Chunk); Index < ChunkEnd(Chunk); ++Index)
+			{
+				++Histogram[(Src[Index] >> Shift) & RadixMask];
+			}
+		});
+
+		// Exclusive prefix sum - digit major then chunk minor - so every chunk scatters into its own slice of each bucket and the sort stays stable
+		int32 Offset = 0;
+
+		for (int32 Digit = 0; Digit < RadixSize; ++Digit)
+		{
+			for (int32 Chunk = 0; Chunk < NumChunks; ++Chunk)
+			{
+				int32& Count = Histograms[Chunk * RadixSize + Digit];
+				const int32 ChunkCount = Count;
+				Count = Offset;
+				Offset += ChunkCount;
+			}
+		}
+
+		ParallelFor(NumChunks, [&](const int32 Chunk)
+		{
+			int32* Histogram = Histograms.GetData() + Chunk * RadixSize;
+
+			for (int32 Index = ChunkBegin(Chunk); Index < ChunkEnd(Chunk); ++Index)
+			{
+				const FMortonCode Code = Src[Index];
+				Dst[Histogram[(Code >> Shift) & RadixMask]++] = Code;
+			}
+		});
+
+		Swap(Src, Dst);
+	}
+
+	// Deduplicate while moving the keys out of whichever buffer the last pass wrote to. Counting first lets every chunk
+	// write to its final offset, and writing to the other buffer avoids chunks overwriting keys a neighbour hasn't read yet.
+	TArray<int32, TInlineAllocator<64>> Offsets;
+	Offsets.SetNumUninitialized(NumChunks + 1);
+	Offsets[0] = 0;
+
+	const auto IsUnique = [Src](const int32 Index) { return Index == 0 || Src[Index] != Src[Index - 1]; };
+
+	ParallelFor(NumChunks, [&](const int32 Chunk)
+	{
+		int32 NumUnique = 0;
+
+		for (int32 Index = ChunkBegin(Chunk); Index < ChunkEnd(Chunk); ++Index)
+		{
+			NumUnique += IsUnique(Index);
+		}
+
+		Offsets[Chunk + 1] = NumUnique;
+	});
+
+	for (int32 Chunk = 0; Chunk < NumChunks; ++Chunk)
+	{
+		Offsets[Chunk + 1] += Offsets[Chunk];
+	}
+
+	ParallelFor(NumChunks, [&](const int32 Chunk)
+	{
+		int32 Offset = Offsets[Chunk];
+
+		for (int32 Index = ChunkBegin(Chunk); Index < ChunkEnd(Chunk); ++Index)
+		{
+			if (IsUnique(Index))
+			{
+				Dst[Offset++] = Src[Index];
+			}
+		}
+	});
+
+	if (Dst == Scratch.GetData())
+	{
+		Codes = MoveTemp(Scratch);
+	}
+
+	Codes.SetNum(Offsets[NumChunks], EAllowShrinking::No);
+}
+
+void NavVolume::Sort::MergeUnique(TConstArrayView<FMortonCode> A, TConstArrayView<FMortonCode> B, TArray<FMortonCode>& Out)
+{
+	// Always split the larger run so the chunk count is based on the data actually being divided
+	if (A.Num() < B.Num())
+	{
+		Swap(A, B);
+	}
+	
+	const int32 NumTotal = A.Num() + B.Num();
+	const int32 NumChunks = GetNumChunks(NumTotal, MinParallelMergeNum);
+
+	if (NumChunks == 1)
+	{
+		Out.SetNumUninitialized(NumTotal);
+		Out.SetNum(MergeUniqueSerial(A.GetData(), A.Num(), B.GetData(), B.Num(), Out.GetData()), EAllowShrinking::No);
+		return;
+	}
+
+	// Split A evenly, moved back to the first of a run of equal codes, and find the matching split in B with a lower bound.
+	// Equal codes of either input then always land in the same chunk, so each chunk can be merged (and deduplicated) without
+	// looking at its neighbours.
+	TArray<int32, TInlineAllocator<64>> SplitA;
+	TArray<int32, TInlineAllocator<64>> SplitB;
+	SplitA.SetNumUninitialized(NumChunks + 1);
+	SplitB.SetNumUninitialized(NumChunks + 1);
+
+	for (int32 Chunk = 0; Chunk < NumChunks; ++Chunk)
+	{
+		const int32 EvenSplit = static_cast<int32>(static_cast<int64>(A.Num()) * Chunk / NumChunks);
+		SplitA[Chunk] = Chunk == 0 ? 0 : Algo::LowerBound(A, A[EvenSplit]);
+		SplitB[Chunk] = Chunk == 0 ? 0 : Algo::LowerBound(B, A[EvenSplit]);
+	}
+	
+	SplitA[NumChunks] = A.Num();
+	SplitB[NumChunks] = B.Num();
+
+	// Merge each chunk into its own buffer as the deduplicated size isn't known up front
+	TArray<TArray<FMortonCode>> ChunkCodes;
+	ChunkCodes.SetNum(NumChunks);
+
+	ParallelFor(NumChunks, [&](const int32 Chunk)
+	{
+		const int32 NumA = SplitA[Chunk + 1] - SplitA[Chunk];
+		const int32 NumB = SplitB[Chunk + 1] - SplitB[Chunk];
+		
+		TArray<FMortonCode>& Codes = ChunkCodes[Chunk];
+		Codes.SetNumUninitialized(NumA + NumB);
+		Codes.SetNum(MergeUniqueSerial(A.GetData() + SplitA[Chunk], NumA, B.GetData() + SplitB[Chunk], NumB, Codes.GetData()), EAllowShrinking::No);
+	});
+
+	// Prefix sum the chunk sizes into output offsets then copy the chunks in parallel
+	TArray<int32, TInlineAllocator<64>> Offsets;
+	Offsets.SetNumUninitialized(NumChunks + 1);
+	Offsets[0] = 0;
+
+	for (int32 Chunk = 0; Chunk < NumChunks; ++Chunk)
+	{
+		Offsets[Chunk + 1] = Offsets[Chunk] + ChunkCodes[Chunk].Num();
+	}
+
+	Out.SetNumUninitialized(Offsets[NumChunks]);
+
+	ParallelFor(NumChunks, [&](const int32 Chunk)
+	{
+		FMemory::Memcpy(Out.GetData() + Offsets[Chunk], ChunkCodes[Chunk].GetData(), ChunkCodes[Chunk].Num() * sizeof(FMortonCode));
+	});
+}
+
+TArray<NavVolume::Morton::FMortonCode> NavVolume::Sort::MergeUnique(TArray<TArray<FMortonCode>>&& Runs)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(NavVolume::MergeUniqueRuns);
+	
+	TArray<TArray<FMortonCode>> ItrRuns = MoveTemp(Runs);
+	ItrRuns.RemoveAll([](const TArray<FMortonCode>& Run) { return Run.IsEmpty(); });
+
+	// Runs covering disjoint ascending ranges (voxelizers given contiguous runs of bins) are concatenated into one exact allocation instead
+	bool bConcatenate = ItrRuns.Num() > 1;
+	
+	for (int32 Run = 1; Run < ItrRuns.Num() && bConcatenate; ++Run)
+	{
+		bConcatenate = ItrRuns[Run - 1].Last() < ItrRuns[Run][0];
+	}
+
+	if (bConcatenate)
+	{
+		TArray<int32> Offsets;
+		Offsets.SetNumUninitialized(ItrRuns.Num() + 1);
+		Offsets[0] = 0;
+
+		for (int32 Run = 0; Run < ItrRuns.Num(); ++Run)
+		{
+			Offsets[Run + 1] = Offsets[Run] + ItrRuns[Run].Num();
+		}
+
+		TArray<FMortonCode> Out;
+		Out.SetNumUninitialized(Offsets.Last());
+
+		ParallelFor(ItrRuns.Num(), [&](const int32 Run)
+		{
+			FMemory::Memcpy(Out.GetData() + Offsets[Run], ItrRuns[Run].GetData(), ItrRuns[Run].Num() * sizeof(FMortonCode));
+			ItrRuns[Run].Empty();
+		});
+
+		return Out;
+	}
+	
+	while (ItrRuns.Num() > 1)
+	{
+		const int32 NumPairs = ItrRuns.Num() / 2;
+		TArray<TArray<FMortonCode>> CurRuns;
+		CurRuns.SetNum(NumPairs + ItrRuns.Num() % 2);
+
+		// Pairs are independent - each one is merged in parallel and may parallelize its own merge further
+		ParallelFor(NumPairs, [&](const int32 Pair)
+		{
+			TArray<FMortonCode>& RunA = ItrRuns[Pair * 2];
+			TArray<FMortonCode>& RunB = ItrRuns[Pair * 2 + 1];
+			MergeUnique(RunA, RunB, CurRuns[Pair]);
+
+			// Release the inputs straight away to keep the peak memory near the size of one round
+			RunA.Empty();
+			RunB.Empty();
+		});
+
+		// An odd run out is carried into the next round untouched
+		if (ItrRuns.Num() % 2 != 0)
+		{
+			CurRuns.Last() = MoveTemp(ItrRuns.Last());
+		}
+
+		ItrRuns = MoveTemp(CurRuns);
+	}
+
+	return ItrRuns.IsEmpty() ? TArray<FMortonCode>() : MoveTemp(ItrRuns[0]);
+}
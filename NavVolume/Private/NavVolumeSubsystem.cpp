@@ -2,3 +2,1227 @@
 
 
 #include "NavVolumeSubsystem.h"
+#include "Async/Async.h"
+#include "AI/Navigation/NavRelevantInterface.h"
+#include "DrawDebugHelpers.h"
+#include "Engine/Level.h"
+#include "Engine/LevelBounds.h"
+#include "Engine/World.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Hash/xxhash.h"
+#include "LandscapeHeightfieldCollisionComponent.h"
+#include "Chaos/HeightField.h"
+#include "Chaos/TriangleMeshImplicitObject.h"
+
+TRACE_DECLARE_INT_COUNTER(NavVolume_VoxelsTested, TEXT("NavVolume/VoxelsTested"));
+TRACE_DECLARE_INT_COUNTER(NavVolume_VoxelsEmitted, TEXT("NavVolume/VoxelsEmitted"));
+TRACE_DECLARE_INT_COUNTER(NavVolume_DuplicateVoxels, TEXT("NavVolume/DuplicateVoxels"));
+
+static TAutoConsoleVariable<int32> CVarNavVolumeDebugDraw(
+	TEXT("NavVolume.DebugDraw"),
+	0,
+	TEXT("Draws volumes as they are published, in editor builds.\n")
+	TEXT("0: off\n")
+	TEXT("1: the tiles each build or update rebuilt, for NavVolume.DebugDrawDuration seconds\n")
+	TEXT("2: the whole volume as persistent lines, replacing whatever was drawn before"));
+
+static TAutoConsoleVariable<float> CVarNavVolumeDebugDrawDuration(
+	TEXT("NavVolume.DebugDrawDuration"),
+	5.f,
+	TEXT("Seconds the tiles drawn by NavVolume.DebugDraw 1 stay on screen."));
+
+static TAutoConsoleVariable<bool> CVarNavVolumeLogBuilds(
+	TEXT("NavVolume.LogBuilds"),
+	false,
+	TEXT("Logs the memory and build stats of every volume and agent profile as it is published."));
+
+namespace
+{
+	/** Start of a cooked volume file - read on its own first so a stale file is rejected before any tile is loaded. */
+	struct FCookedHeader
+	{
+		static constexpr uint32 Magic = 0x4C4F564E; // "NVOL"
+		static constexpr uint32 LatestVersion = 4; // Bump whenever the octree or tile serialization changes
+
+		uint32 FileMagic = Magic;
+		uint32 Version = LatestVersion;
+		int32 VoxelSize = 0;
+		uint8 Layout = static_cast<uint8>(UNavVolumeSubsystem::OctreeLayout);
+		int32 TileLog2Size = UNavVolumeSubsystem::TileLog2Size;
+		uint64 GeometryHash = 0;
+
+		friend FArchive& operator<<(FArchive& Ar, FCookedHeader& Header)
+		{
+			return Ar << Header.FileMagic << Header.Version << Header.VoxelSize << Header.Layout << Header.TileLog2Size << Header.GeometryHash;
+		}
+
+		/** True if the file was written for the same geometry and resolution by a build with the same octree format. */
+		bool Matches(const uint64 InGeometryHash, const int32 InVoxelSize) const
+		{
+			const FCookedHeader Current;
+			return FileMagic == Magic && Version == Current.Version && VoxelSize == InVoxelSize && Layout == Current.Layout
+				&& TileLog2Size == Current.TileLog2Size && GeometryHash == InGeometryHash;
+		}
+	};
+
+	bool IsCookedVolumeCurrent(const FString& Filename, const uint64 GeometryHash, const int32 VoxelSize)
+	{
+		const TUniquePtr<FArchive> Reader(IFileManager::Get().CreateFileReader(*Filename, FILEREAD_Silent));
+
+		if (!Reader.IsValid())
+		{
+			return false;
+		}
+
+		FCookedHeader Header;
+		*Reader << Header;
+		return !Reader->IsError() && Header.Matches(GeometryHash, VoxelSize);
+	}
+
+	void AppendTriMesh(const Chaos::FTriangleMeshImplicitObject& TriMesh, const FTransform& Transform, TArray<FVector>& OutVertices)
+	{
+		const auto AppendTriangles = [&](const auto& Triangles)
+		{
+			for (const auto& Triangle : Triangles)
+			{
+				for (int32 Corner = 0; Corner < 3; ++Corner)
+				{
+					OutVertices.Add(Transform.TransformPosition(FVector(TriMesh.Particles().GetX(Triangle[Corner]))));
+				}
+			}
+		};
+
+		const Chaos::FTrimeshIndexBuffer& Indices = TriMesh.Elements();
+		
+		if (Indices.RequiresLargeIndices()) AppendTriangles(Indices.GetLargeIndexBuffer());
+		else AppendTriangles(Indices.GetSmallIndexBuffer());
+	}
+
+	void AppendHeightField(const Chaos::FHeightField& HeightField, const FTransform& Transform, TArray<FVector>& OutVertices)
+	{
+		const int32 NumRows = HeightField.GetNumRows();
+		const int32 NumCols = HeightField.GetNumCols();
+
+		const auto GetVertex = [&](const int32 X, const int32 Y)
+		{
+			return Transform.TransformPosition(FVector(HeightField.GetPointScaled(Y * NumCols + X)));
+		};
+
+		// Two triangles per cell that isn't a hole
+		for (int32 Y = 0; Y < NumRows - 1; ++Y)
+		for (int32 X = 0; X < NumCols - 1; ++X)
+		{
+			if (!HeightField.IsHole(X, Y))
+			{
+				OutVertices.Append({ GetVertex(X, Y), GetVertex(X, Y + 1), GetVertex(X + 1, Y + 1) });
+				OutVertices.Append({ GetVertex(X, Y), GetVertex(X + 1, Y + 1), GetVertex(X + 1, Y) });
+			}
+		}
+	}
+
+	/** World space triangles of collision that has no simple shapes - meshes using complex as simple, and landscape heightfields. */
+	TArray<FVector> GetCollisionTriangles(const UPrimitiveComponent* Component, const UBodySetup* BodySetup, const FTransform& Transform)
+	{
+		TArray<FVector> Vertices;
+
+		if (BodySetup != nullptr && BodySetup->GetCollisionTraceFlag() == CTF_UseComplexAsSimple)
+		{
+			for (const Chaos::FTriangleMeshImplicitObjectPtr& TriMesh : BodySetup->TriMeshGeometries)
+			{
+				if (TriMesh.IsValid()) AppendTriMesh(*TriMesh, Transform, Vertices);
+			}
+		}
+
+		if (const ULandscapeHeightfieldCollisionComponent* Landscape = Cast<ULandscapeHeightfieldCollisionComponent>(Component))
+		{
+			if (Landscape->HeightfieldRef.IsValid() && Landscape->HeightfieldRef->HeightfieldGeometry)
+			{
+				AppendHeightField(*Landscape->HeightfieldRef->HeightfieldGeometry, Transform, Vertices);
+			}
+		}
+
+		return Vertices;
+	}
+
+	/** Up to six boxes covering the part of A outside B. */
+	TArray<FBox, TInlineAllocator<6>> SubtractBox(const FBox& A, const FBox& B)
+	{
+		TArray<FBox, TInlineAllocator<6>> Pieces;
+
+		if (!A.Intersect(B))
+		{
+			Pieces.Add(A);
+			return Pieces;
+		}
+
+		// Slabs are cut off one axis at a time, the rest shrinks to the overlap
+		FBox Rest = A;
+
+		for (int32 Axis = 0; Axis < 3; ++Axis)
+		{
+			if (Rest.Min[Axis] < B.Min[Axis])
+			{
+				FBox Slab = Rest;
+				Slab.Max[Axis] = Rest.Min[Axis] = B.Min[Axis];
+				Pieces.Add(Slab);
+			}
+
+			if (Rest.Max[Axis] > B.Max[Axis])
+			{
+				FBox Slab = Rest;
+				Slab.Min[Axis] = Rest.Max[Axis] = B.Max[Axis];
+				Pieces.Add(Slab);
+			}
+		}
+
+		return Pieces;
+	}
+
+	/** The tiled octree behind a volume - its voxel size is known from the settings the volume was built with. */
+	template<int32 VoxelSize>
+	const UNavVolumeSubsystem::TTiledOctree<VoxelSize>& GetTiledOctree(const UNavVolumeSubsystem::FVolumePtr& Volume)
+	{
+		check(Volume->GetVoxelSize() == VoxelSize);
+		return static_cast<const UNavVolumeSubsystem::TTiledOctree<VoxelSize>&>(*Volume);
+	}
+}
+
+void UNavVolumeSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	// Streaming cells (and streamed sublevels) bring their geometry in and out with them
+	FWorldDelegates::LevelAddedToWorld.AddUObject(this, &UNavVolumeSubsystem::OnLevelAddedToWorld);
+	FWorldDelegates::LevelRemovedFromWorld.AddUObject(this, &UNavVolumeSubsystem::OnLevelRemovedFromWorld);
+
+	// Components come and go, and change collision, with their physics state
+	UActorComponent::GlobalCreatePhysicsDelegate.AddUObject(this, &UNavVolumeSubsystem::OnComponentPhysicsStateChanged, true);
+	UActorComponent::GlobalDestroyPhysicsDelegate.AddUObject(this, &UNavVolumeSubsystem::OnComponentPhysicsStateChanged, false);
+}
+
+void UNavVolumeSubsystem::Deinitialize()
+{
+	FWorldDelegates::LevelAddedToWorld.RemoveAll(this);
+	FWorldDelegates::LevelRemovedFromWorld.RemoveAll(this);
+	UActorComponent::GlobalCreatePhysicsDelegate.RemoveAll(this);
+	UActorComponent::GlobalDestroyPhysicsDelegate.RemoveAll(this);
+
+	for (const TPair<TWeakObjectPtr<USceneComponent>, FBox>& Tracked : TrackedComponents)
+	{
+		if (USceneComponent* Component = Tracked.Key.Get()) Component->TransformUpdated.RemoveAll(this);
+	}
+
+	TrackedComponents.Empty();
+	FTSTicker::GetCoreTicker().RemoveTicker(FlushDirtyHandle);
+	Super::Deinitialize();
+}
+
+UNavVolumeSubsystem::FBuildTask UNavVolumeSubsystem::CreateNavigableVolume(const FBox& WorldBounds, const NavVolume::Task::FVoxelizerSettings& Settings, const FString& CookedFilename)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UNavVolumeSubsystem::CreateNavigableVolume);
+	
+	FBuildTask BuildTask = NavVolume::Voxel::DispatchVoxelSize(Settings.VoxelSize, [&](auto VoxelSize)
+	{
+		return CookedFilename.IsEmpty() ? LaunchBuild<decltype(VoxelSize)::Value>(WorldBounds, Settings)
+			: LaunchLoadCooked<decltype(VoxelSize)::Value>(WorldBounds, Settings, CookedFilename, GatherGeometrySources(WorldBounds));
+	});
+
+	FNavigableVolume& Volume = FindOrAddNavigableVolume(WorldBounds);
+	Volume.Settings = Settings;
+	Volume.Latest = BuildTask;
+
+	// Updates still running against the previous build never replace this one, even if they finish after it
+	Volume.BuildId = LaunchPublish(WorldBounds, BuildTask);
+
+	// A rebuild starts every profile over, the radii may have changed with the settings
+	TArray<float> AgentRadii = Settings.AgentRadii;
+	AgentRadii.RemoveAll([](const float AgentRadius) { return AgentRadius <= 0.f; });
+
+	// Obstacles grow at most a tile so only neighbouring tiles reach in - a larger agent would be given a volume it doesn't fit, so it gets none
+	const float MaxAgentRadius = static_cast<float>(Settings.VoxelSize << TileLog2Size);
+	AgentRadii.RemoveAll([&WorldBounds, MaxAgentRadius](const float AgentRadius)
+	{
+		if (AgentRadius <= MaxAgentRadius) return false;
+
+		UE_LOG(LogTemp, Warning, TEXT("NavVolume: agent radius %.1f is over the largest of %.1f (a tile), no profile is built for it in %s"),
+			AgentRadius, MaxAgentRadius, *WorldBounds.ToString());
+		return true;
+	});
+	AgentRadii.Sort();
+	Volume.Profiles.Reset();
+
+	for (const float AgentRadius : AgentRadii)
+	{
+		if (Volume.Profiles.IsEmpty() || Volume.Profiles.Last().AgentRadius != AgentRadius)
+		{
+			Volume.Profiles.Add(FAgentProfile { AgentRadius });
+		}
+	}
+
+	LaunchAgentProfiles(Volume, FBox(ForceInit));
+	return BuildTask;
+}
+
+template<int32 VoxelSize>
+UNavVolumeSubsystem::FBuildTask UNavVolumeSubsystem::LaunchBuild(const FBox& WorldBounds, const NavVolume::Task::FVoxelizerSettings& Settings)
+{
+	FNavVolumeBuildStats Stats;
+	const TSharedPtr<NavVolume::Stats::FVoxelizeCounters> Counters = MakeShared<NavVolume::Stats::FVoxelizeCounters>();
+	TArray<FVoxelizeTask> VoxelizeTasks = LaunchVoxelizers<VoxelSize>(WorldBounds, Settings, false, Stats, Counters);
+
+	// Merge stage - only scheduled once every voxelizer has finished so GetResult() never blocks
+	// Each voxelizer returns a sorted unique run so they only need merging, not another global sort
+	// The merged codes are then split by tile and every tile is built in parallel
+	FBuildTask BuildTask = UE::Tasks::Launch(UE_SOURCE_LOCATION,
+		[VoxelizeTasks, WorldBounds, bCollapseSolids = Settings.bSolidInterior, Stats = MoveTemp(Stats), Counters]() mutable -> FVolumePtr
+	{
+		TRACE_CPUPROFILER_EVENT_SCOPE(NavVolume::MergeAndBuildTiles);
+		Counters->CopyTo(Stats);
+		const double MergeStartTime = FPlatformTime::Seconds();
+		
+		TArray<NavVolume::Octree::FOctreeCodes> Runs;
+		Runs.Reserve(VoxelizeTasks.Num());
+
+		for (FVoxelizeTask& TaskHandle : VoxelizeTasks)
+		{
+			Runs.Add(MoveTemp(TaskHandle.GetResult()));
+		}
+
+		NavVolume::Octree::FOctreeCodes Codes = NavVolume::Octree::FOctreeCodes::Merge(MoveTemp(Runs));
+		Stats.NumLeaves = Codes.Leaves.Num();
+		Stats.PeakCodeBytes += Codes.GetAllocatedSize();
+		Stats.PeakUsedPhysical = FPlatformMemory::GetStats().PeakUsedPhysical;
+
+		// Only tiles with geometry are built, every other tile of the bounds is free space
+		TMap<NavVolume::Morton::FMortonCode, NavVolume::Octree::FOctreeCodes> TileCodes = NavVolume::Tile::SplitTiles(MoveTemp(Codes), TileLog2Size);
+		TArray<TPair<NavVolume::Morton::FMortonCode, NavVolume::Octree::FOctreeCodes>> Tiles;
+		Tiles.Reserve(TileCodes.Num());
+
+		for (TPair<NavVolume::Morton::FMortonCode, NavVolume::Octree::FOctreeCodes>& Tile : TileCodes)
+		{
+			Tiles.Emplace(Tile.Key, MoveTemp(Tile.Value));
+		}
+
+		Stats.MergeSeconds = FPlatformTime::Seconds() - MergeStartTime;
+
+		TSharedPtr<TTiledOctree<VoxelSize>> Volume = MakeShared<TTiledOctree<VoxelSize>>(TileLog2Size);
+		Volume->SetBounds(WorldBounds);
+		Volume->BuildTiles(MoveTemp(Tiles), bCollapseSolids, &Stats);
+		Volume->SetBuildStats(MoveTemp(Stats));
+		return Volume;
+	}, VoxelizeTasks);
+}
+
+template<int32 VoxelSize>
+UNavVolumeSubsystem::FBuildTask UNavVolumeSubsystem::LaunchLoadCooked(const FBox& WorldBounds, const NavVolume::Task::FVoxelizerSettings& Settings, const FString& Filename,
+	TArray<FGeometrySource>&& Sources)
+{
+	// The volume is either read from the file, or built when the file is stale - the build reads the geometry so the game thread launches it
+	struct FLoadState
+	{
+		FVolumePtr Loaded;
+		FBuildTask Fallback;
+	};
+
+	const TSharedRef<FLoadState> State = MakeShared<FLoadState>();
+	UE::Tasks::FTaskEvent FallbackLaunched(UE_SOURCE_LOCATION);
+
+	const UE::Tasks::FTask LoadTask = UE::Tasks::Launch(UE_SOURCE_LOCATION,
+		[WeakThis = TWeakObjectPtr<UNavVolumeSubsystem>(this), WorldBounds, Settings, Filename, Sources = MoveTemp(Sources), State, FallbackLaunched]() mutable
+	{
+		TRACE_CPUPROFILER_EVENT_SCOPE(NavVolume::LoadCooked);
+		
+		const uint64 GeometryHash = HashGeometrySources(MoveTemp(Sources), WorldBounds, Settings);
+		const bool bCurrent = IsCookedVolumeCurrent(Filename, GeometryHash, Settings.VoxelSize);
+		TSharedPtr<TTiledOctree<VoxelSize>> Volume = MakeShared<TTiledOctree<VoxelSize>>(TileLog2Size);
+		const TUniquePtr<FArchive> Reader(bCurrent ? IFileManager::Get().CreateFileReader(*Filename, FILEREAD_Silent) : nullptr);
+
+		if (Reader.IsValid())
+		{
+			FCookedHeader Header;
+			*Reader << Header;
+			Volume->Serialize(*Reader);
+		}
+
+		if (Reader.IsValid() && !Reader->IsError())
+		{
+			State->Loaded = MoveTemp(Volume);
+			FallbackLaunched.Trigger();
+			return;
+		}
+
+		if (bCurrent)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("NavVolume: failed to load %s, building instead"), *Filename);
+		}
+
+		// Stale or unreadable - a partly read volume is dropped and the returned task waits for the build instead
+		AsyncTask(ENamedThreads::GameThread, [WeakThis, WorldBounds, Settings, Filename, GeometryHash, State, FallbackLaunched]() mutable
+		{
+			UNavVolumeSubsystem* Subsystem = WeakThis.Get();
+
+			// Unless the volume was removed in the meantime - nothing is published for it then, an empty volume stands in
+			if (Subsystem == nullptr || !Subsystem->NavigableVolumes.ContainsByPredicate([&WorldBounds](const FNavigableVolume& Candidate) { return Candidate.WorldBounds == WorldBounds; }))
+			{
+				TSharedPtr<TTiledOctree<VoxelSize>> Empty = MakeShared<TTiledOctree<VoxelSize>>(TileLog2Size);
+				Empty->SetBounds(WorldBounds);
+				State->Loaded = MoveTemp(Empty);
+				FallbackLaunched.Trigger();
+				return;
+			}
+
+			State->Fallback = Subsystem->LaunchBuild<VoxelSize>(WorldBounds, Settings);
+			FallbackLaunched.AddPrerequisites(State->Fallback);
+			FallbackLaunched.Trigger();
+
+			// Only editor worlds write the file - it is staged with the content and only read by games
+#if WITH_EDITOR
+			if (Subsystem->GetWorld()->WorldType == EWorldType::Editor)
+			{
+				Subsystem->LaunchSaveCooked(Filename, GeometryHash, State->Fallback);
+			}
+#endif // WITH_EDITOR
+		});
+	});
+
+	// Resolves to the loaded or the built volume, so the caller's task is a future for the real volume either way
+	return UE::Tasks::Launch(UE_SOURCE_LOCATION, [State]() -> FVolumePtr
+	{
+		return State->Loaded.IsValid() ? State->Loaded : State->Fallback.GetResult();
+	}, UE::Tasks::Prerequisites(LoadTask, FallbackLaunched));
+}
+
+void UNavVolumeSubsystem::LaunchSaveCooked(const FString& Filename, const uint64 GeometryHash, const FBuildTask& VolumeTask)
+{
+	UE::Tasks::Launch(UE_SOURCE_LOCATION, [Filename, GeometryHash, VolumeTask]()
+	{
+		TRACE_CPUPROFILER_EVENT_SCOPE(NavVolume::SaveCooked);
+		
+		// Written next to the file and moved over it so a reader never sees half a volume
+		const FString TempFilename = Filename + TEXT(".tmp");
+		TUniquePtr<FArchive> Writer(IFileManager::Get().CreateFileWriter(*TempFilename));
+
+		if (!Writer.IsValid())
+		{
+			UE_LOG(LogTemp, Warning, TEXT("NavVolume: failed to write %s"), *TempFilename);
+			return;
+		}
+
+		// Saving only reads the volume, it stays immutable
+		const TSharedPtr<NavVolume::Tile::INavigableVolume> Volume = ConstCastSharedPtr<NavVolume::Tile::INavigableVolume>(VolumeTask.GetResult());
+		
+		FCookedHeader Header;
+		Header.VoxelSize = Volume->GetVoxelSize();
+		Header.GeometryHash = GeometryHash;
+		*Writer << Header;
+		Volume->Serialize(*Writer);
+
+		const bool bWritten = Writer->Close();
+		Writer.Reset();
+
+		if (bWritten && IFileManager::Get().Move(*Filename, *TempFilename))
+		{
+			UE_LOG(LogTemp, Log, TEXT("NavVolume: saved %s"), *Filename);
+		}
+	}, UE::Tasks::Prerequisites(VolumeTask));
+}
+
+TArray<UNavVolumeSubsystem::FGeometrySource> UNavVolumeSubsystem::GatherGeometrySources(const FBox& WorldBounds)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UNavVolumeSubsystem::GatherGeometrySources);
+	
+	TArray<FOverlapResult> Overlaps = GetBoxOverlaps(WorldBounds, ECC_WorldStatic);
+	TArray<FGeometrySource> Sources;
+	Sources.Reserve(Overlaps.Num());
+
+	for (const FOverlapResult& Overlap : Overlaps)
+	{
+		INavRelevantInterface* Interface = Cast<INavRelevantInterface>(Overlap.Component);
+
+		if (Interface == nullptr || !Interface->IsNavigationRelevant())
+		{
+			continue;
+		}
+
+		// Everything a voxelizer reads - the transform, the bounds it is clipped to and an id of the shapes
+		FGeometrySource& Source = Sources.AddDefaulted_GetRef();
+		Source.Transform = Interface->GetNavigableGeometryTransform().ToMatrixWithScale();
+		Source.NavigationBounds = Interface->GetNavigationBounds();
+
+		if (const ULandscapeHeightfieldCollisionComponent* Landscape = Cast<ULandscapeHeightfieldCollisionComponent>(Overlap.Component.Get()))
+		{
+			Source.Guid = Landscape->HeightfieldGuid;
+		}
+		else if (const UBodySetup* BodySetup = Interface->GetNavigableGeometryBodySetup())
+		{
+			Source.Guid = BodySetup->BodySetupGuid;
+		}
+	}
+
+	return Sources;
+}
+
+uint64 UNavVolumeSubsystem::HashGeometrySources(TArray<FGeometrySource>&& Sources, const FBox& WorldBounds, const NavVolume::Task::FVoxelizerSettings& Settings)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UNavVolumeSubsystem::HashGeometrySources);
+	TArray<uint64> SourceHashes;
+	SourceHashes.Reserve(Sources.Num());
+
+	for (const FGeometrySource& Source : Sources)
+	{
+		FXxHash64Builder Builder;
+		Builder.Update(&Source.Transform.M, sizeof(Source.Transform.M));
+		Builder.Update(&Source.NavigationBounds.Min, sizeof(FVector));
+		Builder.Update(&Source.NavigationBounds.Max, sizeof(FVector));
+		Builder.Update(&Source.Guid, sizeof(FGuid));
+		SourceHashes.Add(Builder.Finalize().Hash);
+	}
+
+	// Overlaps come back in no particular order - the components are combined sorted so the same scene always hashes the same
+	SourceHashes.Sort();
+	
+	FXxHash64Builder Builder;
+	Builder.Update(SourceHashes.GetData(), SourceHashes.Num() * sizeof(uint64));
+	Builder.Update(&WorldBounds.Min, sizeof(FVector));
+	Builder.Update(&WorldBounds.Max, sizeof(FVector));
+	Builder.Update(&Settings.bSolidInterior, sizeof(bool));
+	Builder.Update(&Settings.VoxelSize, sizeof(int32));
+	return Builder.Finalize().Hash;
+}
+
+template<int32 VoxelSize>
+TArray<UNavVolumeSubsystem::FVoxelizeTask> UNavVolumeSubsystem::LaunchVoxelizers(const FBox& WorldBounds, const NavVolume::Task::FVoxelizerSettings& Settings, const bool bClipToBounds,
+	FNavVolumeBuildStats& OutStats, const TSharedPtr<NavVolume::Stats::FVoxelizeCounters>& Counters)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UNavVolumeSubsystem::LaunchVoxelizers);
+	const double StartTime = FPlatformTime::Seconds();
+	
+	TArray<FOverlapResult> Overlaps;
+	
+	{
+		TRACE_CPUPROFILER_EVENT_SCOPE(NavVolume::OverlapQuery);
+		Overlaps = GetBoxOverlaps(WorldBounds, ECC_WorldStatic);
+	}
+	
+	TSharedPtr<NavVolume::BroadPhase::FShapeSet> ShapeSet = MakeShared<NavVolume::BroadPhase::FShapeSet>();
+
+	for (const FOverlapResult& Overlap : Overlaps)
+	{
+		INavRelevantInterface* Interface = Cast<INavRelevantInterface>(Overlap.Component);
+
+		if (Interface != nullptr && Interface->IsNavigationRelevant())
+		{
+			const FBox NavigationBounds = Interface->GetNavigationBounds();
+			const FBox Bounds = bClipToBounds ? NavigationBounds.Overlap(WorldBounds) : NavigationBounds;
+
+			if (!Bounds.IsValid)
+			{
+				continue;
+			}
+			
+			const UBodySetup* BodySetup = Interface->GetNavigableGeometryBodySetup();
+			const FTransform Transform = Interface->GetNavigableGeometryTransform();
+			const bool bComplexAsSimple = BodySetup != nullptr && BodySetup->GetCollisionTraceFlag() == CTF_UseComplexAsSimple;
+
+			// Simple shapes aren't used for collision when the complex mesh stands in for them
+			const int32 ComponentIndex = ShapeSet->AddComponent(Transform, Bounds, BodySetup != nullptr && !bComplexAsSimple ? BodySetup->AggGeom : FKAggregateGeom());
+			TArray<FVector> Triangles = GetCollisionTriangles(Overlap.Component.Get(), BodySetup, Transform);
+
+			if (!Triangles.IsEmpty())
+			{
+				ShapeSet->AddTriangles(ComponentIndex, MoveTemp(Triangles));
+			}
+		}
+	}
+
+	// A few runs per worker, so a run that turns out slower than its estimate doesn't hold up the merge
+	TArray<NavVolume::BroadPhase::FBin> Bins;
+
+	{
+		TRACE_CPUPROFILER_EVENT_SCOPE(NavVolume::BinShapes);
+		Bins = NavVolume::BroadPhase::BinShapes<VoxelSize>(*ShapeSet);
+	}
+
+	OutStats.NumComponents = ShapeSet->Components.Num();
+	OutStats.NumShapes = ShapeSet->Shapes.Num();
+	OutStats.NumBins = Bins.Num();
+
+	for (const NavVolume::BroadPhase::FBin& Bin : Bins)
+	{
+		OutStats.NumVoxelsTested += Bin.NumVoxels;
+	}
+
+	const int32 NumRuns = FMath::Max(1, FTaskGraphInterface::Get().GetNumWorkerThreads() * 4);
+	TArray<FVoxelizeTask> VoxelizeTasks;
+
+	for (NavVolume::BroadPhase::TBinVoxelizer<VoxelSize>& Voxelizer : NavVolume::BroadPhase::MakeBinVoxelizers<VoxelSize>(ShapeSet, MoveTemp(Bins), NumRuns, Settings.bSolidInterior, Counters))
+	{
+		VoxelizeTasks.Add(UE::Tasks::Launch(UE_SOURCE_LOCATION, MoveTemp(Voxelizer)));
+	}
+
+	OutStats.NumVoxelizeTasks = VoxelizeTasks.Num();
+	OutStats.OverlapSeconds = FPlatformTime::Seconds() - StartTime;
+	return VoxelizeTasks;
+}
+
+uint64 UNavVolumeSubsystem::LaunchPublish(const FBox& WorldBounds, const FBuildTask& VolumeTask, const float AgentRadius)
+{
+	check(IsInGameThread());
+	const uint64 BuildId = ++LastBuildId;
+	
+	// Publish stage - debug drawing and listeners both need the game thread
+	UE::Tasks::Launch(UE_SOURCE_LOCATION, [WeakThis = TWeakObjectPtr<UNavVolumeSubsystem>(this), WorldBounds, VolumeTask, AgentRadius, BuildId]() mutable
+	{
+		AsyncTask(ENamedThreads::GameThread, [WeakThis, WorldBounds, AgentRadius, BuildId, Volume = VolumeTask.GetResult()]()
+		{
+			if (UNavVolumeSubsystem* Subsystem = WeakThis.Get())
+			{
+				Subsystem->PublishNavigableVolume(WorldBounds, AgentRadius, BuildId, Volume);
+			}
+		});
+	}, UE::Tasks::Prerequisites(VolumeTask));
+
+	return BuildId;
+}
+
+void UNavVolumeSubsystem::RemoveNavigableVolume(const FBox& WorldBounds)
+{
+	check(IsInGameThread());
+	NavigableVolumes.RemoveAll([&WorldBounds](const FNavigableVolume& Volume) { return Volume.WorldBounds == WorldBounds; });
+}
+
+void UNavVolumeSubsystem::MarkDirty(const FBox& DirtyBounds)
+{
+	check(IsInGameThread());
+
+	// Overlapping regions are rebuilt as one, e.g. the bounds of an obstacle moving a little every frame
+	if (FBox* Overlapping = DirtyRegions.FindByPredicate([&DirtyBounds](const FBox& Region) { return Region.Intersect(DirtyBounds); }))
+	{
+		*Overlapping += DirtyBounds;
+	}
+	else
+	{
+		DirtyRegions.Add(DirtyBounds);
+	}
+
+	// Regions marked within the same frame are flushed together
+	if (!FlushDirtyHandle.IsValid())
+	{
+		FlushDirtyHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateWeakLambda(this, [this](float)
+		{
+			FlushDirtyHandle.Reset();
+			FlushDirtyRegions();
+			return false;
+		}));
+	}
+}
+
+void UNavVolumeSubsystem::FlushDirtyRegions()
+{
+	const TArray<FBox> Regions = MoveTemp(DirtyRegions);
+	
+	for (const FBox& DirtyBounds : Regions)
+	{
+		for (int32 VolumeIndex = 0; VolumeIndex < NavigableVolumes.Num(); ++VolumeIndex)
+		{
+			const FBox WorldBounds = NavigableVolumes[VolumeIndex].WorldBounds;
+			
+			if (NavigableVolumes[VolumeIndex].Latest.IsValid() && WorldBounds.Intersect(DirtyBounds))
+			{
+				UpdateNavigableVolume(WorldBounds, WorldBounds.Overlap(DirtyBounds), false);
+			}
+		}
+	}
+}
+
+void UNavVolumeSubsystem::LoadNavigableRegion(const FBox& RegionBounds)
+{
+	for (int32 VolumeIndex = 0; VolumeIndex < NavigableVolumes.Num(); ++VolumeIndex)
+	{
+		const FBox WorldBounds = NavigableVolumes[VolumeIndex].WorldBounds;
+
+		if (NavigableVolumes[VolumeIndex].Latest.IsValid() && WorldBounds.Intersect(RegionBounds))
+		{
+			UpdateNavigableVolume(WorldBounds, WorldBounds.Overlap(RegionBounds), true);
+		}
+	}
+}
+
+void UNavVolumeSubsystem::UnloadNavigableRegion(const FBox& RegionBounds)
+{
+	for (FNavigableVolume& Volume : NavigableVolumes)
+	{
+		if (!Volume.Latest.IsValid() || !Volume.WorldBounds.Intersect(RegionBounds))
+		{
+			continue;
+		}
+
+		Volume.Latest = NavVolume::Voxel::DispatchVoxelSize(Volume.Settings.VoxelSize, [&](auto VoxelSize)
+		{
+			return LaunchUnload<decltype(VoxelSize)::Value>(Volume.WorldBounds, RegionBounds, Volume.Latest);
+		});
+		
+		LaunchPublish(Volume.WorldBounds, Volume.Latest);
+		LaunchAgentProfiles(Volume, RegionBounds);
+	}
+
+	MarkDirty(RegionBounds);
+}
+
+void UNavVolumeSubsystem::MoveNavigableVolume(const FBox& OldBounds, const FBox& NewBounds)
+{
+	check(IsInGameThread());
+	FNavigableVolume* Volume = NavigableVolumes.FindByPredicate([&OldBounds](const FNavigableVolume& Candidate) { return Candidate.WorldBounds == OldBounds; });
+
+	if (Volume == nullptr || !Volume->Latest.IsValid() || OldBounds == NewBounds)
+	{
+		return;
+	}
+
+	// Publishes still running for the old bounds find nothing there and are dropped, the ones launched here include their result
+	Volume->WorldBounds = NewBounds;
+	Volume->Latest = NavVolume::Voxel::DispatchVoxelSize(Volume->Settings.VoxelSize, [&](auto VoxelSize)
+	{
+		return LaunchClip<decltype(VoxelSize)::Value>(NewBounds, Volume->Latest);
+	});
+
+	LaunchPublish(NewBounds, Volume->Latest);
+	FBox LeftBounds(ForceInit);
+
+	for (const FBox& Piece : SubtractBox(OldBounds, NewBounds))
+	{
+		LeftBounds += Piece;
+	}
+
+	// Profiles drop the tiles the volume dropped whenever they are dilated, only the ones reaching into them need dilating again
+	if (LeftBounds.IsValid)
+	{
+		LaunchAgentProfiles(*Volume, LeftBounds);
+	}
+
+	for (const FBox& Piece : SubtractBox(NewBounds, OldBounds))
+	{
+		UpdateNavigableVolume(NewBounds, Piece, true);
+	}
+}
+
+template<int32 VoxelSize>
+UNavVolumeSubsystem::FBuildTask UNavVolumeSubsystem::LaunchClip(const FBox& WorldBounds, const FBuildTask& PreviousTask)
+{
+	return UE::Tasks::Launch(UE_SOURCE_LOCATION, [PreviousTask, WorldBounds]() mutable -> FVolumePtr
+	{
+		const TTiledOctree<VoxelSize>& Previous = GetTiledOctree<VoxelSize>(PreviousTask.GetResult());
+		TArray<NavVolume::Morton::FMortonCode> OutsideKeys;
+
+		for (const typename TTiledOctree<VoxelSize>::FTile& Tile : Previous.GetTiles())
+		{
+			if (!WorldBounds.Intersect(Previous.GetTileBounds(Tile.Key))) OutsideKeys.Add(Tile.Key);
+		}
+
+		TSharedPtr<TTiledOctree<VoxelSize>> Clipped = MakeShared<TTiledOctree<VoxelSize>>(Previous);
+		Clipped->RemoveTiles(OutsideKeys);
+		Clipped->SetBounds(WorldBounds);
+		return Clipped;
+	}, UE::Tasks::Prerequisites(PreviousTask));
+}
+
+template<int32 VoxelSize>
+UNavVolumeSubsystem::FBuildTask UNavVolumeSubsystem::LaunchUnload(const FBox& WorldBounds, const FBox& RegionBounds, const FBuildTask& PreviousTask)
+{
+	// Only tiles completely inside the region lose all of their geometry
+	TArray<NavVolume::Morton::FMortonCode> TileKeys = NavVolume::Tile::GetTileKeys<VoxelSize>(WorldBounds.Overlap(RegionBounds), TileLog2Size);
+	TileKeys.RemoveAll([&RegionBounds](const NavVolume::Morton::FMortonCode Key)
+	{
+		return !RegionBounds.IsInside(TTiledOctree<VoxelSize>::FOctree::GetCellBounds(Key << (3 * TileLog2Size), TileLog2Size));
+	});
+
+	return UE::Tasks::Launch(UE_SOURCE_LOCATION, [PreviousTask, TileKeys = MoveTemp(TileKeys)]() mutable -> FVolumePtr
+	{
+		TSharedPtr<TTiledOctree<VoxelSize>> Unloaded = MakeShared<TTiledOctree<VoxelSize>>(GetTiledOctree<VoxelSize>(PreviousTask.GetResult()));
+		Unloaded->UnloadTiles(TileKeys);
+		return Unloaded;
+	}, UE::Tasks::Prerequisites(PreviousTask));
+}
+
+void UNavVolumeSubsystem::UpdateNavigableVolume(const FBox& WorldBounds, const FBox& DirtyBounds, const bool bLoadTiles)
+{
+	FNavigableVolume& Volume = FindOrAddNavigableVolume(WorldBounds);
+	
+	Volume.Latest = NavVolume::Voxel::DispatchVoxelSize(Volume.Settings.VoxelSize, [&](auto VoxelSize)
+	{
+		return LaunchUpdate<decltype(VoxelSize)::Value>(DirtyBounds, Volume.Settings, Volume.Latest, bLoadTiles);
+	});
+	
+	LaunchPublish(WorldBounds, Volume.Latest);
+	LaunchAgentProfiles(Volume, DirtyBounds);
+}
+
+template<int32 VoxelSize>
+UNavVolumeSubsystem::FBuildTask UNavVolumeSubsystem::LaunchUpdate(const FBox& DirtyBounds, const NavVolume::Task::FVoxelizerSettings& Settings, const FBuildTask& PreviousTask, const bool bLoadTiles)
+{
+	FIntVector VoxelMin, VoxelMax;
+	NavVolume::Voxel::GetVoxelRange<VoxelSize>(DirtyBounds, VoxelMin, VoxelMax);
+
+	// Grow the region to aligned cubes, each one a contiguous range of codes - sized so at most 3 are needed per axis
+	const FIntVector NumVoxels = VoxelMax - VoxelMin + FIntVector(1);
+	const int32 MinLog2Size = bLoadTiles ? TileLog2Size : NavVolume::Voxel::LeafBlockLog2Size;
+	const int32 Log2Size = FMath::Max(MinLog2Size, static_cast<int32>(FMath::CeilLogTwo(static_cast<uint32>(NumVoxels.GetMax()))) - 1);
+	const int32 AlignMask = (1 << Log2Size) - 1;
+	
+	VoxelMin = FIntVector(VoxelMin.X & ~AlignMask, VoxelMin.Y & ~AlignMask, VoxelMin.Z & ~AlignMask);
+	VoxelMax = FIntVector(VoxelMax.X | AlignMask, VoxelMax.Y | AlignMask, VoxelMax.Z | AlignMask);
+
+	TArray<NavVolume::Morton::FMortonCode> RegionCodes;
+	
+	for (int32 X = VoxelMin.X; X <= VoxelMax.X; X += 1 << Log2Size)
+	for (int32 Y = VoxelMin.Y; Y <= VoxelMax.Y; Y += 1 << Log2Size)
+	for (int32 Z = VoxelMin.Z; Z <= VoxelMax.Z; Z += 1 << Log2Size)
+	{
+		RegionCodes.Add(NavVolume::Morton::EncodeMorton(FIntVector(X, Y, Z)));
+	}
+
+	RegionCodes.Sort();
+
+	const FBox RegionBounds = NavVolume::Voxel::GetVoxelRangeBounds<VoxelSize>(VoxelMin, VoxelMax);
+	FNavVolumeBuildStats Stats;
+	const TSharedPtr<NavVolume::Stats::FVoxelizeCounters> Counters = MakeShared<NavVolume::Stats::FVoxelizeCounters>();
+	TArray<FVoxelizeTask> VoxelizeTasks = LaunchVoxelizers<VoxelSize>(RegionBounds, Settings, true, Stats, Counters);
+	TArray<NavVolume::Morton::FMortonCode> TileKeys = NavVolume::Tile::GetTileKeys<VoxelSize>(RegionBounds, TileLog2Size);
+
+	// Splice stage - waits on the previous state of the volume too, so overlapping updates apply in the order they were marked
+	// Only the tiles the region touches are spliced and rebuilt, every other tile is shared with the previous state
+	return UE::Tasks::Launch(UE_SOURCE_LOCATION,
+		[PreviousTask, VoxelizeTasks, RegionCodes = MoveTemp(RegionCodes), TileKeys = MoveTemp(TileKeys), Log2Size, bLoadTiles,
+		 bCollapseSolids = Settings.bSolidInterior, Stats = MoveTemp(Stats), Counters]() mutable -> FVolumePtr
+	{
+		TRACE_CPUPROFILER_EVENT_SCOPE(NavVolume::SpliceAndBuildTiles);
+		Counters->CopyTo(Stats);
+		const double MergeStartTime = FPlatformTime::Seconds();
+		
+		TArray<NavVolume::Octree::FOctreeCodes> Runs;
+		Runs.Reserve(VoxelizeTasks.Num());
+
+		for (FVoxelizeTask& TaskHandle : VoxelizeTasks)
+		{
+			Runs.Add(MoveTemp(TaskHandle.GetResult()));
+		}
+
+		NavVolume::Octree::FOctreeCodes RegionCodesMerged = NavVolume::Octree::FOctreeCodes::Merge(MoveTemp(Runs));
+		Stats.NumLeaves = RegionCodesMerged.Leaves.Num();
+		Stats.PeakCodeBytes += RegionCodesMerged.GetAllocatedSize();
+		Stats.PeakUsedPhysical = FPlatformMemory::GetStats().PeakUsedPhysical;
+		TMap<NavVolume::Morton::FMortonCode, NavVolume::Octree::FOctreeCodes> RegionTiles = NavVolume::Tile::SplitTiles(MoveTemp(RegionCodesMerged), TileLog2Size);
+		
+		const TTiledOctree<VoxelSize>& Previous = GetTiledOctree<VoxelSize>(PreviousTask.GetResult());
+		TArray<TPair<NavVolume::Morton::FMortonCode, NavVolume::Octree::FOctreeCodes>> Tiles;
+
+		for (const NavVolume::Morton::FMortonCode Key : TileKeys)
+		{
+			// A tile that isn't loaded is built when its streaming cell loads, not from part of its geometry
+			if (!bLoadTiles && !Previous.IsTileLoaded(Key))
+			{
+				continue;
+			}
+
+			NavVolume::Octree::FOctreeCodes TileRegion;
+			RegionTiles.RemoveAndCopyValue(Key, TileRegion);
+			
+			const NavVolume::Octree::FOctreeCodes TileCodes = Previous.GetTileCodes(Key);
+			Tiles.Emplace(Key, TileCodes.Splice(RegionCodes, Log2Size, MoveTemp(TileRegion)));
+		}
+
+		Stats.MergeSeconds = FPlatformTime::Seconds() - MergeStartTime;
+
+		TSharedPtr<TTiledOctree<VoxelSize>> Updated = MakeShared<TTiledOctree<VoxelSize>>(Previous);
+		Updated->BuildTiles(MoveTemp(Tiles), bCollapseSolids, &Stats);
+		Updated->SetBuildStats(MoveTemp(Stats));
+		return Updated;
+	}, UE::Tasks::Prerequisites(PreviousTask, VoxelizeTasks));
+}
+
+void UNavVolumeSubsystem::OnLevelAddedToWorld(ULevel* Level, UWorld* World)
+{
+	if (World == GetWorld() && Level != nullptr && !Level->IsPersistentLevel())
+	{
+		const FBox LevelBounds = ALevelBounds::CalculateLevelBounds(Level);
+		if (LevelBounds.IsValid) LoadNavigableRegion(LevelBounds);
+	}
+}
+
+void UNavVolumeSubsystem::OnLevelRemovedFromWorld(ULevel* Level, UWorld* World)
+{
+	// A null level means the whole world is being torn down
+	if (World == GetWorld() && Level != nullptr && !Level->IsPersistentLevel())
+	{
+		const FBox LevelBounds = ALevelBounds::CalculateLevelBounds(Level);
+		if (LevelBounds.IsValid) UnloadNavigableRegion(LevelBounds);
+	}
+}
+
+void UNavVolumeSubsystem::OnComponentPhysicsStateChanged(UActorComponent* Component, const bool bCreated)
+{
+	USceneComponent* SceneComponent = Cast<USceneComponent>(Component);
+	INavRelevantInterface* Interface = Cast<INavRelevantInterface>(Component);
+
+	if (SceneComponent == nullptr || Interface == nullptr || Component->GetWorld() != GetWorld() || GetWorld()->bIsTearingDown)
+	{
+		return;
+	}
+
+	FBox OldBounds(ForceInit);
+	TrackedComponents.RemoveAndCopyValue(SceneComponent, OldBounds);
+	SceneComponent->TransformUpdated.RemoveAll(this);
+
+	const FBox NewBounds = bCreated && Interface->IsNavigationRelevant() ? Interface->GetNavigationBounds() : FBox(ForceInit);
+
+	// Only movable components move at runtime, in the editor anything does
+	if (NewBounds.IsValid && (SceneComponent->Mobility == EComponentMobility::Movable || GetWorld()->WorldType == EWorldType::Editor))
+	{
+		TrackedComponents.Add(SceneComponent, NewBounds);
+		SceneComponent->TransformUpdated.AddUObject(this, &UNavVolumeSubsystem::OnComponentTransformUpdated);
+	}
+
+	const ULevel* Level = Component->GetComponentLevel();
+
+	if (NavigableVolumes.IsEmpty() || Level == nullptr || !Level->bIsVisible || Level->bIsBeingRemoved)
+	{
+		return;
+	}
+
+	// A component that wasn't tracked was last voxelized where it is now
+	const FBox DirtyBounds = bCreated ? OldBounds + NewBounds : (OldBounds.IsValid ? OldBounds : Interface->GetNavigationBounds());
+
+	if (DirtyBounds.IsValid)
+	{
+		MarkDirty(DirtyBounds);
+	}
+}
+
+void UNavVolumeSubsystem::OnComponentTransformUpdated(USceneComponent* Component, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport)
+{
+	FBox* TrackedBounds = TrackedComponents.Find(Component);
+	INavRelevantInterface* Interface = Cast<INavRelevantInterface>(Component);
+
+	if (TrackedBounds == nullptr || Interface == nullptr)
+	{
+		return;
+	}
+
+	const FBox NewBounds = Interface->IsNavigationRelevant() ? Interface->GetNavigationBounds() : FBox(ForceInit);
+
+	if (NewBounds == *TrackedBounds)
+	{
+		return;
+	}
+
+	// Both where it was (now free) and where it is (now blocked)
+	if (!NavigableVolumes.IsEmpty())
+	{
+		MarkDirty(*TrackedBounds + NewBounds);
+	}
+
+	*TrackedBounds = NewBounds;
+}
+
+void UNavVolumeSubsystem::PublishNavigableVolume(const FBox& WorldBounds, const float AgentRadius, const uint64 BuildId, FVolumePtr Volume)
+{
+	check(IsInGameThread());
+	TRACE_CPUPROFILER_EVENT_SCOPE(UNavVolumeSubsystem::PublishNavigableVolume);
+
+	// A volume removed (or rebuilt from scratch) while this was running stays removed, and an older volume never replaces a newer one
+	FNavigableVolume* NavigableVolume = NavigableVolumes.FindByPredicate([&WorldBounds](const FNavigableVolume& Candidate) { return Candidate.WorldBounds == WorldBounds; });
+
+	if (NavigableVolume == nullptr || BuildId < NavigableVolume->BuildId)
+	{
+		return;
+	}
+
+	if (AgentRadius > 0.f)
+	{
+		// A profile the volume was rebuilt without since is dropped
+		FAgentProfile* Profile = NavigableVolume->Profiles.FindByPredicate([AgentRadius](const FAgentProfile& Candidate) { return Candidate.AgentRadius == AgentRadius; });
+
+		if (Profile != nullptr && BuildId > Profile->PublishedId)
+		{
+			if (CVarNavVolumeLogBuilds.GetValueOnGameThread())
+			{
+				UE_LOG(LogTemp, Log, TEXT("NavVolume: agent profile of radius %.1f"), AgentRadius);
+				Volume->LogMemoryUsage();
+				Volume->GetBuildStats().Log();
+			}
+			
+			Profile->Volume = Volume;
+			Profile->PublishedId = BuildId;
+		}
+
+		return;
+	}
+
+	if (BuildId <= NavigableVolume->PublishedId)
+	{
+		return;
+	}
+
+	if (CVarNavVolumeLogBuilds.GetValueOnGameThread())
+	{
+		Volume->LogMemoryUsage();
+		Volume->GetBuildStats().Log();
+	}
+
+	// Drawing every voxel of the volume on each update would take far longer than the update, so by default only its rebuilt tiles are
+	// drawn, as lines that expire rather than piling up
+	switch (CVarNavVolumeDebugDraw.GetValueOnGameThread())
+	{
+	case 1:
+		Volume->DebugDraw(GetWorld(), true, CVarNavVolumeDebugDrawDuration.GetValueOnGameThread());
+		break;
+	case 2:
+		FlushPersistentDebugLines(GetWorld());
+		Volume->DebugDraw(GetWorld(), false, -1.f);
+		break;
+	default:
+		break;
+	}
+
+	// A rebuild of the same bounds replaces the volume, queries already running keep the old one alive
+	NavigableVolume->Volume = Volume;
+	NavigableVolume->PublishedId = BuildId;
+	OnNavigableVolumeBuilt.Broadcast(WorldBounds, Volume);
+}
+
+UNavVolumeSubsystem::FNavigableVolume& UNavVolumeSubsystem::FindOrAddNavigableVolume(const FBox& WorldBounds)
+{
+	check(IsInGameThread());
+	
+	if (FNavigableVolume* Volume = NavigableVolumes.FindByPredicate([&WorldBounds](const FNavigableVolume& Volume) { return Volume.WorldBounds == WorldBounds; }))
+	{
+		return *Volume;
+	}
+
+	return NavigableVolumes.Add_GetRef(FNavigableVolume { WorldBounds });
+}
+
+void UNavVolumeSubsystem::LaunchAgentProfiles(FNavigableVolume& Volume, const FBox& DirtyBounds)
+{
+	for (FAgentProfile& Profile : Volume.Profiles)
+	{
+		// Obstacles grow by whole voxels so an agent never fits a gap narrower than itself - radii over a tile have no profile
+		const int32 Radius = FMath::CeilToInt32(Profile.AgentRadius / Volume.Settings.VoxelSize);
+		check(Radius <= 1 << TileLog2Size);
+
+		Profile.Latest = NavVolume::Voxel::DispatchVoxelSize(Volume.Settings.VoxelSize, [&](auto VoxelSize)
+		{
+			return LaunchDilate<decltype(VoxelSize)::Value>(Volume.Latest, Profile.Latest, DirtyBounds, Radius, Volume.Settings.bSolidInterior);
+		});
+
+		LaunchPublish(Volume.WorldBounds, Profile.Latest, Profile.AgentRadius);
+	}
+}
+
+template<int32 VoxelSize>
+UNavVolumeSubsystem::FBuildTask UNavVolumeSubsystem::LaunchDilate(const FBuildTask& BaseTask, const FBuildTask& PreviousTask, const FBox& DirtyBounds,
+	const int32 Radius, const bool bCollapseSolids)
+{
+	// Leaves up to Radius outside the region grow into it, so every tile within that reach is dilated again
+	const bool bRebuildAll = !PreviousTask.IsValid() || !DirtyBounds.IsValid;
+	TArray<NavVolume::Morton::FMortonCode> TileKeys = bRebuildAll ? TArray<NavVolume::Morton::FMortonCode>()
+		: NavVolume::Tile::GetTileKeys<VoxelSize>(DirtyBounds.ExpandBy(Radius * VoxelSize), TileLog2Size);
+
+	// Waits on the previous state of the profile too, so it follows the updates of the volume in the order they were launched
+	return UE::Tasks::Launch(UE_SOURCE_LOCATION, [BaseTask, PreviousTask, TileKeys = MoveTemp(TileKeys), bRebuildAll, Radius, bCollapseSolids]() mutable -> FVolumePtr
+	{
+		TRACE_CPUPROFILER_EVENT_SCOPE(NavVolume::DilateAgentProfile);
+		
+		const TTiledOctree<VoxelSize>& Base = GetTiledOctree<VoxelSize>(BaseTask.GetResult());
+		TSharedPtr<TTiledOctree<VoxelSize>> Dilated = bRebuildAll
+			? MakeShared<TTiledOctree<VoxelSize>>(TileLog2Size)
+			: MakeShared<TTiledOctree<VoxelSize>>(GetTiledOctree<VoxelSize>(PreviousTask.GetResult()));
+
+		if (bRebuildAll)
+		{
+			// Leaves grow into the empty tiles around them too
+			for (const typename TTiledOctree<VoxelSize>::FTile& Tile : Base.GetTiles())
+			{
+				TileKeys.Append(NavVolume::Tile::GetTileKeys<VoxelSize>(Base.GetTileBounds(Tile.Key).ExpandBy(Radius * VoxelSize), TileLog2Size));
+			}
+		}
+		else
+		{
+			// Tiles the volume unloaded since are unloaded from the profile too
+			TArray<NavVolume::Morton::FMortonCode> UnloadedKeys;
+
+			for (const typename TTiledOctree<VoxelSize>::FTile& Tile : Dilated->GetTiles())
+			{
+				if (!Base.IsTileLoaded(Tile.Key)) UnloadedKeys.Add(Tile.Key);
+			}
+
+			Dilated->RemoveTiles(UnloadedKeys);
+
+			// Tiles the volume loaded since are dilated whole, along with the neighbours their leaves grow into
+			for (const NavVolume::Morton::FMortonCode Key : Dilated->GetUnloadedTileKeys())
+			{
+				if (Base.IsTileLoaded(Key))
+				{
+					TileKeys.Append(NavVolume::Tile::GetTileKeys<VoxelSize>(Base.GetTileBounds(Key).ExpandBy(Radius * VoxelSize), TileLog2Size));
+				}
+			}
+		}
+
+		NavVolume::Sort::SortUnique(TileKeys);
+		Dilated->CopyBounds(Base);
+
+		FNavVolumeBuildStats Stats;
+		Dilated->BuildDilatedTiles(Base, TileKeys, Radius, bCollapseSolids, &Stats);
+		Dilated->SetBuildStats(MoveTemp(Stats));
+		return Dilated;
+	}, UE::Tasks::Prerequisites(BaseTask, PreviousTask.IsValid() ? PreviousTask : BaseTask));
+}
+
+UNavVolumeSubsystem::FVolumePtr UNavVolumeSubsystem::FindNavigableVolume(const FVector& Position, const float AgentRadius) const
+{
+	check(IsInGameThread());
+	
+	for (const FNavigableVolume& Volume : NavigableVolumes)
+	{
+		if (!Volume.Volume.IsValid() || !Volume.WorldBounds.IsInsideOrOn(Position))
+		{
+			continue;
+		}
+
+		if (AgentRadius <= 0.f)
+		{
+			return Volume.Volume;
+		}
+
+		// Profiles are sorted by radius, the first one that fits is the least conservative
+		const FAgentProfile* Profile = Volume.Profiles.FindByPredicate([AgentRadius](const FAgentProfile& Candidate) { return Candidate.AgentRadius >= AgentRadius; });
+		return Profile != nullptr ? Profile->Volume : nullptr;
+	}
+
+	return nullptr;
+}
+
+TFuture<UNavVolumeSubsystem::FPathResult> UNavVolumeSubsystem::FindPathAsync(const FVector& Start, const FVector& End, const NavVolume::Path::FPathSettings& Settings)
+{
+	const NavVolume::Path::FPathRequest Request { Start, End };
+	return MoveTemp(FindPathsAsync(MakeArrayView(&Request, 1), Settings)[0]);
+}
+
+TArray<TFuture<UNavVolumeSubsystem::FPathResult>> UNavVolumeSubsystem::FindPathsAsync(TConstArrayView<NavVolume::Path::FPathRequest> Requests, const NavVolume::Path::FPathSettings& Settings)
+{
+	struct FPathJob
+	{
+		NavVolume::Path::FPathRequest Request;
+		FVolumePtr Volume;
+		TPromise<FPathResult> Promise;
+	};
+
+	TArray<TFuture<FPathResult>> Futures;
+	Futures.Reserve(Requests.Num());
+
+	// Enough batches to keep every worker busy, each one reuses its thread's search scratch across its paths
+	const int32 NumWorkers = FMath::Max(1, FTaskGraphInterface::Get().GetNumWorkerThreads());
+	const int32 BatchSize = FMath::DivideAndRoundUp(Requests.Num(), NumWorkers);
+
+	for (int32 BatchBegin = 0; BatchBegin < Requests.Num(); BatchBegin += BatchSize)
+	{
+		TArray<FPathJob> Jobs;
+		Jobs.Reserve(BatchSize);
+
+		for (int32 RequestIndex = BatchBegin; RequestIndex < FMath::Min(BatchBegin + BatchSize, Requests.Num()); ++RequestIndex)
+		{
+			FPathJob& Job = Jobs.Add_GetRef(FPathJob { Requests[RequestIndex], FindNavigableVolume(Requests[RequestIndex].Start, Settings.AgentRadius) });
+			Futures.Add(Job.Promise.GetFuture());
+		}
+
+		UE::Tasks::Launch(UE_SOURCE_LOCATION, [Jobs = MoveTemp(Jobs), Settings]() mutable
+		{
+			TRACE_CPUPROFILER_EVENT_SCOPE(NavVolume::FindPaths);
+			
+			for (FPathJob& Job : Jobs)
+			{
+				Job.Promise.SetValue(Job.Volume.IsValid()
+					? Job.Volume->FindPath(Job.Request.Start, Job.Request.End, Settings)
+					: FPathResult());
+			}
+		});
+	}
+
+	return Futures;
+}
+
+NavVolume::Voxel::FRaycastHit UNavVolumeSubsystem::Raycast(const FVector& Start, const FVector& End, const float AgentRadius) const
+{
+	NavVolume::Voxel::FRaycastHit Hit;
+	const NavVolume::Voxel::FRaycastRequest Request { Start, End };
+	RaycastBatch(MakeArrayView(&Request, 1), MakeArrayView(&Hit, 1), AgentRadius);
+	return Hit;
+}
+
+void UNavVolumeSubsystem::RaycastBatch(TConstArrayView<NavVolume::Voxel::FRaycastRequest> Requests, TArrayView<NavVolume::Voxel::FRaycastHit> OutHits, const float AgentRadius) const
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UNavVolumeSubsystem::RaycastBatch);
+	check(Requests.Num() == OutHits.Num());
+
+	// Volumes are looked up here as the published list is only read on the game thread
+	TArray<FVolumePtr> Volumes;
+	Volumes.Reserve(Requests.Num());
+
+	for (const NavVolume::Voxel::FRaycastRequest& Request : Requests)
+	{
+		Volumes.Add(FindNavigableVolume(Request.Start, AgentRadius));
+	}
+
+	ParallelFor(TEXT("NavVolume.RaycastBatch"), Requests.Num(), 64, [&](const int32 Index)
+	{
+		OutHits[Index] = Volumes[Index].IsValid() ? Volumes[Index]->Raycast(Requests[Index].Start, Requests[Index].End) : NavVolume::Voxel::FRaycastHit();
+
+		if (!OutHits[Index].bBlocked)
+		{
+			OutHits[Index].Location = Requests[Index].End;
+		}
+	});
+}
+
+/** Fires batches of random paths inside the first volume and logs the throughput of each agent count, e.g. "NavVolume.BenchmarkPaths 1 10 100 1000". */
+static FAutoConsoleCommandWithWorldAndArgs BenchmarkPathsCommand(
+	TEXT("NavVolume.BenchmarkPaths"),
+	TEXT("Logs paths per second for each agent count given as arguments."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		UNavVolumeSubsystem* Subsystem = World != nullptr ? World->GetSubsystem<UNavVolumeSubsystem>() : nullptr;
+		const FBox WorldBounds = Subsystem != nullptr ? Subsystem->GetNavigableBounds() : FBox(ForceInit);
+
+		if (!WorldBounds.IsValid)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("NavVolume.BenchmarkPaths: no navigable volume has been built"));
+			return;
+		}
+
+		for (const FString& Arg : Args)
+		{
+			const int32 NumAgents = FMath::Max(1, FCString::Atoi(*Arg));
+			
+			TArray<NavVolume::Path::FPathRequest> Requests;
+			
+			for (int32 AgentIndex = 0; AgentIndex < NumAgents; ++AgentIndex)
+			{
+				Requests.Add({ FMath::RandPointInBox(WorldBounds), FMath::RandPointInBox(WorldBounds) });
+			}
+
+			const double StartTime = FPlatformTime::Seconds();
+			TArray<TFuture<UNavVolumeSubsystem::FPathResult>> Futures = Subsystem->FindPathsAsync(Requests);
+			int32 NumFound = 0;
+
+			for (TFuture<UNavVolumeSubsystem::FPathResult>& Future : Futures)
+			{
+				NumFound += Future.Get().bSuccess;
+			}
+
+			const double Seconds = FPlatformTime::Seconds() - StartTime;
+			UE_LOG(LogTemp, Log, TEXT("NavVolume.BenchmarkPaths: %d agents, %d found, %.3f ms, %.0f paths/s"),
+				NumAgents, NumFound, Seconds * 1000.0, NumAgents / FMath::Max(Seconds, UE_DOUBLE_SMALL_NUMBER));
+		}
+	})
+);
@@ -4,6 +4,7 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "Containers/Ticker.h"
 #include "NavVolumeArea.generated.h"
 
 class UBrushComponent;
@@ -17,6 +18,7 @@ public:
 	ANavVolumeArea(const FObjectInitializer& ObjectInitializer);
 
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 	virtual void PostRegisterAllComponents() override;
 	virtual void PostUnregisterAllComponents() override;
 	
@@ -26,4 +28,45 @@ public:
 
 	static void OnPostEngineInit();
 #endif // WITH_EDITOR
+
+	/** Fill the inside of shapes with solid octree nodes instead of individual voxels - flight only needs to know the interior is blocked. */
+	UPROPERTY(EditAnywhere, Category = "Navigation")
+	bool bSolidInterior = true;
+
+	/** Edge length of a voxel in world units - 16, 32, 64 or 128, other values snap to the nearest of them when edited.
+	 *	Fine voxels suit cramped interiors, coarse ones open sky.
+	 */
+	UPROPERTY(EditAnywhere, Category = "Navigation", meta = (ClampMin = "16", ClampMax = "128"))
+	int32 VoxelSize = 32;
+
+	/** Radii of agents larger than a point that fly in this area - each gets its own octree with obstacles grown to fit it (see FPathSettings::AgentRadius).
+	 *	At most 128 voxels, larger radii are skipped with a warning.
+	 */
+	UPROPERTY(EditAnywhere, Category = "Navigation", meta = (ClampMin = "0"))
+	TArray<float> AgentRadii;
+
+	/** Load the volume saved by the editor instead of building it when the geometry hasn't changed since.
+	 *	The files are written to Content/NavVolume, which has to be staged as non-UFS (DirectoriesToAlwaysStageAsNonUFS) to ship.
+	 */
+	UPROPERTY(EditAnywhere, Category = "Navigation")
+	bool bUseCookedData = true;
+
+private:
+	/** File the volume of this area is saved to and loaded from - one per area of each map. */
+	FString GetCookedFilename() const;
+
+	/** Builds the whole volume again, replacing the one built for the previous bounds. */
+	void RebuildNavigableVolume();
+
+	/** Rebuilds once the area stopped changing for RebuildDelay seconds - dragging it in the editor changes it every frame. */
+	void RequestRebuild();
+
+	/** Moves the volume along with the area at runtime - only the region it uncovered is built. */
+	void OnAreaTransformUpdated(USceneComponent* Component, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport);
+
+	static constexpr float RebuildDelay = 0.5f;
+	FTSTicker::FDelegateHandle RebuildHandle;
+
+	/** Bounds of the last build - the subsystem keys volumes by them. */
+	FBox BuiltBounds = FBox(ForceInit);
 };
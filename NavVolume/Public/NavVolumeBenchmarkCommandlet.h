@@ -0,0 +1,27 @@
+//
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "NavVolumeBenchmarkCommandlet.generated.h"
+
+/** Times morton encoding, every shape voxelizer and the octree build on seeded synthetic scenes - no map or rendered world needed.
+ *	The scene also goes through the production build stage by stage (BinShapes, bin voxelizers, merge, BuildTiles), whose output is
+ *	checked against the per shape voxelizers. The radix sort and merges are checked against Algo::Sort, the SIMD shape tests against
+ *	the scalar ones and the chunked octree build against a serial one, whose times show how it scales. Returns an error if any fast
+ *	path differs from its reference code. The merge of voxelizer runs is timed against appending and sorting them, with the peak
+ *	memory of each, at the code counts of -MergeCodes (1M, 10M and 100M by default).
+ *	Results are written as JSON so runs of different releases can be compared, e.g.
+ *	UnrealEditor-Cmd <Project> -run=NavVolumeBenchmark -nullrhi -Seed=1 -Shapes=256 -VoxelSize=32 -MergeCodes=1000000,10000000 -Output=Saved/NavVolume/Benchmark.json
+ */
+UCLASS()
+class NAVVOLUME_API UNavVolumeBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UNavVolumeBenchmarkCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,457 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "NavVolumeMorton.h"
+#include "NavVolumeVoxel.h"
+#include "NavVolumeSort.h"
+#include "NavVolumeOctree.h"
+#include "NavVolumeStats.h"
+
+/** Prepass of a build that bins every shape of every overlap into coarse morton aligned blocks by its bounds.
+ *	A bin is voxelized once against only the shapes that reach it, so voxels shared by overlapping shapes are emitted once and blocks
+ *	already filled by one shape are skipped by the rest.
+ */
+namespace NavVolume::BroadPhase
+{
+	using namespace NavVolume::Morton;
+	using namespace NavVolume::Voxel;
+	using namespace NavVolume::Octree;
+
+	/** Size of a bin as a power of 2 voxels per axis - the occupancy of its voxels is a 4KB mask. */
+	constexpr int32 BinLog2Size = 5;
+	constexpr int32 BinNumVoxels = 1 << (3 * BinLog2Size);
+
+	/** Every shape of the overlaps of a build - copied so nothing waits on the tasks before a body setup could change. */
+	struct FShapeSet
+	{
+		enum class EShapeType : uint8
+		{
+			Box,
+			Sphere,
+			Sphyl,
+			Convex,
+			Triangle,
+		};
+
+		struct FComponent
+		{
+			FTransform Transform;
+			FBox Bounds; // Navigation bounds, clipped to the region when only a region is voxelized
+			TArray<FKBoxElem> BoxElems;
+			TArray<FKSphereElem> SphereElems;
+			TArray<FKSphylElem> SphylElems;
+			TArray<FKConvexElem> ConvexElems;
+			TArray<FVector> TriangleVertices; // World space, 3 per triangle - complex collision and heightfields
+		};
+
+		struct FShape
+		{
+			int32 Component;
+			EShapeType Type;
+			int32 Index;
+			FBox Bounds; // World bounds of the shape clipped to its component's bounds
+		};
+
+		TArray<FComponent> Components;
+		TArray<FShape> Shapes;
+
+		/** Adds the simple shapes of a component, returns its index. */
+		int32 AddComponent(const FTransform& Transform, const FBox& Bounds, const FKAggregateGeom& AggGeom)
+		{
+			const int32 ComponentIndex = Components.Add(FComponent { Transform, Bounds, AggGeom.BoxElems, AggGeom.SphereElems, AggGeom.SphylElems, AggGeom.ConvexElems });
+			const FMatrix WorldTransform = Transform.ToMatrixWithScale();
+
+			// Local bounds of an element in the frame of its own transform (the same frame its shape test works in)
+			const auto AddShapes = [&](const auto& Elems, const EShapeType Type, const auto& GetLocalBounds)
+			{
+				for (int32 Index = 0; Index < Elems.Num(); ++Index)
+				{
+					const FBox WorldBounds = GetLocalBounds(Elems[Index]).TransformBy(Elems[Index].GetTransform().ToMatrixWithScale() * WorldTransform);
+
+					if (WorldBounds.Intersect(Bounds))
+					{
+						Shapes.Add(FShape { ComponentIndex, Type, Index, WorldBounds.Overlap(Bounds) });
+					}
+				}
+			};
+
+			AddShapes(AggGeom.BoxElems, EShapeType::Box, [](const FKBoxElem& Box) { return FBox::BuildAABB(FVector::ZeroVector, FVector(Box.X, Box.Y, Box.Z) * 0.5); });
+			AddShapes(AggGeom.SphereElems, EShapeType::Sphere, [](const FKSphereElem& Sphere) { return FBox::BuildAABB(FVector::ZeroVector, FVector(Sphere.Radius)); });
+			AddShapes(AggGeom.SphylElems, EShapeType::Sphyl, [](const FKSphylElem& Sphyl) { return FBox::BuildAABB(FVector::ZeroVector, FVector(Sphyl.Radius, Sphyl.Radius, Sphyl.Radius + Sphyl.Length * 0.5)); });
+			AddShapes(AggGeom.ConvexElems, EShapeType::Convex, [](const FKConvexElem& Convex) { return Convex.ElemBox; });
+			return ComponentIndex;
+		}
+
+		/** Adds a triangle soup to a component - every triangle is binned on its own, so large meshes spread over many tasks. */
+		void AddTriangles(const int32 ComponentIndex, TArray<FVector>&& WorldVertices)
+		{
+			check(WorldVertices.Num() % 3 == 0);
+			FComponent& Component = Components[ComponentIndex];
+			Component.TriangleVertices = MoveTemp(WorldVertices);
+
+			for (int32 Index = 0; Index < Component.TriangleVertices.Num() / 3; ++Index)
+			{
+				const FVector* Vertices = &Component.TriangleVertices[3 * Index];
+				FBox TriangleBounds(ForceInit);
+				TriangleBounds += Vertices[0];
+				TriangleBounds += Vertices[1];
+				TriangleBounds += Vertices[2];
+
+				if (TriangleBounds.Intersect(Component.Bounds))
+				{
+					Shapes.Add(FShape { ComponentIndex, EShapeType::Triangle, Index, TriangleBounds.Overlap(Component.Bounds) });
+				}
+			}
+		}
+	};
+
+	/** A coarse block of 2^BinLog2Size voxels per axis and the shapes whose bounds reach it, largest first. */
+	struct FBin
+	{
+		FMortonCode Key; // Leaf code of any voxel of the bin >> 3 * BinLog2Size
+		TArray<int32> Shapes;
+		int64 NumVoxels = 0; // Estimated work - the voxels of the bin each shape's range covers, summed over its shapes
+		int64 NumSurfaceVoxels = 0; // Estimated leaves with solid interiors - the voxels on the faces of each of those ranges
+	};
+
+	/** Assigns every shape to the bins its voxel range covers - the bins come back sorted by key, so in morton order. */
+	template<int32 VoxelSize>
+	TArray<FBin> BinShapes(const FShapeSet& ShapeSet)
+	{
+		TMap<FMortonCode, FBin> BinsByKey;
+
+		for (int32 ShapeIndex = 0; ShapeIndex < ShapeSet.Shapes.Num(); ++ShapeIndex)
+		{
+			FIntVector VoxelMin, VoxelMax;
+			GetVoxelRange<VoxelSize>(ShapeSet.Shapes[ShapeIndex].Bounds, VoxelMin, VoxelMax);
+
+			for (int32 X = VoxelMin.X >> BinLog2Size; X <= VoxelMax.X >> BinLog2Size; ++X)
+			for (int32 Y = VoxelMin.Y >> BinLog2Size; Y <= VoxelMax.Y >> BinLog2Size; ++Y)
+			for (int32 Z = VoxelMin.Z >> BinLog2Size; Z <= VoxelMax.Z >> BinLog2Size; ++Z)
+			{
+				const FIntVector BinMin = FIntVector(X, Y, Z) * (1 << BinLog2Size);
+				const FIntVector BinMax = BinMin + FIntVector((1 << BinLog2Size) - 1);
+				const FIntVector Extent = FIntVector(
+					FMath::Min(VoxelMax.X, BinMax.X) - FMath::Max(VoxelMin.X, BinMin.X) + 1,
+					FMath::Min(VoxelMax.Y, BinMax.Y) - FMath::Max(VoxelMin.Y, BinMin.Y) + 1,
+					FMath::Min(VoxelMax.Z, BinMax.Z) - FMath::Max(VoxelMin.Z, BinMin.Z) + 1);
+				
+				FBin& Bin = BinsByKey.FindOrAdd(EncodeMorton(BinMin) >> (3 * BinLog2Size));
+				Bin.Shapes.Add(ShapeIndex);
+				const int64 NumVoxels = static_cast<int64>(Extent.X) * Extent.Y * Extent.Z;
+				Bin.NumVoxels += NumVoxels;
+				Bin.NumSurfaceVoxels += FMath::Min<int64>(NumVoxels, 2 * (Extent.X * Extent.Y + Extent.Y * Extent.Z + Extent.X * Extent.Z));
+			}
+		}
+
+		TArray<FBin> Bins;
+		Bins.Reserve(BinsByKey.Num());
+
+		for (TPair<FMortonCode, FBin>& Pair : BinsByKey)
+		{
+			// Large shapes are the most likely to fill whole blocks, so they go first and the smaller ones skip what they filled
+			// Triangles are flat and always last
+			Pair.Value.Shapes.Sort([&ShapeSet](const int32 A, const int32 B)
+			{
+				return ShapeSet.Shapes[A].Bounds.GetVolume() > ShapeSet.Shapes[B].Bounds.GetVolume();
+			});
+
+			Pair.Value.Key = Pair.Key;
+			Bins.Add(MoveTemp(Pair.Value));
+		}
+
+		Bins.Sort([](const FBin& A, const FBin& B) { return A.Key < B.Key; });
+		return Bins;
+	}
+
+	/** Voxelizes a sorted run of bins - the result is sorted and unique so it can be merged as a run.
+	 *	Each bin keeps a mask of the voxels it has emitted, indexed by their morton code within the bin, so a block is one contiguous
+	 *	range of bits and testing whether a block is already filled is a scan of a few words.
+	 */
+	template<int32 VoxelSize>
+	struct TBinVoxelizer
+	{
+		TSharedPtr<const FShapeSet> ShapeSet;
+		TArray<FBin> Bins;
+		bool bSolidInterior = true;
+
+		/** Buffers kept per worker and reused by every bin it voxelizes, so they stop allocating once warm. */
+		struct FScratch
+		{
+			TArray<uint64> Occupied;
+			TArray<FMortonCode> BinCodes;
+			TArray<FIntVector> PendingVoxels;
+			TArray<FMortonCode> PendingCodes;
+
+			static FScratch& Get()
+			{
+				static thread_local FScratch Scratch;
+				return Scratch;
+			}
+		};
+		
+		TSharedPtr<NavVolume::Stats::FVoxelizeCounters> Counters; // Optional - totals of the build this run is part of
+
+		FOctreeCodes operator()() const
+		{
+			TRACE_CPUPROFILER_EVENT_SCOPE(NavVolume::TBinVoxelizer);
+			const uint64 StartCycles = FPlatformTime::Cycles64();
+			
+			FOctreeCodes Codes;
+			
+			// The run is sized from the bins' estimates up front so it is written without reallocating - an estimate that
+			// falls short only costs the usual growth
+			int64 NumLeaves = 0;
+			int64 NumTested = 0;
+
+			for (const FBin& Bin : Bins)
+			{
+				NumLeaves += FMath::Min<int64>(BinNumVoxels, bSolidInterior ? Bin.NumSurfaceVoxels : Bin.NumVoxels);
+				NumTested += Bin.NumVoxels;
+			}
+
+			Codes.Leaves.Reserve(static_cast<int32>(FMath::Min<int64>(NumLeaves, MAX_int32)));
+			int64 NumAllocations = Codes.Leaves.Max() > 0 ? 1 : 0;
+			
+			FScratch& Scratch = FScratch::Get();
+			TArray<FMortonCode>& BinCodes = Scratch.BinCodes;
+			TArray<uint64>& Occupied = Scratch.Occupied;
+			Occupied.SetNumUninitialized(BinNumVoxels / 64);
+
+			int64 NumEmitted = 0;
+			int64 NumDuplicates = 0;
+
+			for (const FBin& Bin : Bins)
+			{
+				FMemory::Memzero(Occupied.GetData(), Occupied.Num() * sizeof(uint64));
+				BinCodes.Reset();
+				VoxelizeBin(Bin, Scratch, Codes.Solids, NumEmitted, NumDuplicates);
+
+				// Bins are disjoint ranges of codes in key order - sorting each bin on its own sorts the run
+				NavVolume::Sort::SortUnique(BinCodes);
+				const int32 PreviousMax = Codes.Leaves.Max();
+				Codes.Leaves.Append(BinCodes);
+				NumAllocations += Codes.Leaves.Max() != PreviousMax;
+			}
+
+			for (TArray<FMortonCode>& LevelCodes : Codes.Solids)
+			{
+				NavVolume::Sort::SortUnique(LevelCodes);
+			}
+
+			TRACE_COUNTER_ADD(NavVolume_VoxelsTested, NumTested);
+			TRACE_COUNTER_ADD(NavVolume_VoxelsEmitted, NumEmitted);
+			TRACE_COUNTER_ADD(NavVolume_DuplicateVoxels, NumDuplicates);
+
+			if (Counters.IsValid())
+			{
+				Counters->NumVoxelsEmitted += NumEmitted;
+				Counters->NumDuplicateVoxels += NumDuplicates;
+				Counters->VoxelizeCycles += FPlatformTime::Cycles64() - StartCycles;
+				Counters->NumRunAllocations += NumAllocations;
+				Counters->RunBytes += Codes.GetAllocatedSize();
+			}
+
+			return Codes;
+		}
+
+	private:
+		static constexpr int32 EncodeBatchSize = 1024;
+		
+		/** Voxelizes the shapes of a bin into Scratch.BinCodes - OutNumEmitted and OutNumDuplicates are added to, not reset. */
+		void VoxelizeBin(const FBin& Bin, FScratch& Scratch, TArray<TArray<FMortonCode>>& OutSolids, int64& OutNumEmitted, int64& OutNumDuplicates) const
+		{
+			const FMortonCode BinBase = Bin.Key << (3 * BinLog2Size);
+			TArray<uint64>& Occupied = Scratch.Occupied;
+			TArray<FMortonCode>& OutCodes = Scratch.BinCodes;
+			TArray<FIntVector>& PendingVoxels = Scratch.PendingVoxels;
+			TArray<FMortonCode>& PendingCodes = Scratch.PendingCodes;
+
+			const auto IsSet = [&Occupied](const int32 Begin, const int32 Count)
+			{
+				if (Count < 64)
+				{
+					// Aligned blocks smaller than a word never straddle one
+					const uint64 Mask = ((uint64(1) << Count) - 1) << (Begin & 63);
+					return (Occupied[Begin >> 6] & Mask) == Mask;
+				}
+
+				for (int32 Word = Begin >> 6; Word < (Begin + Count) >> 6; ++Word)
+				{
+					if (Occupied[Word] != MAX_uint64) return false;
+				}
+
+				return true;
+			};
+
+			const auto IsBlockCovered = [&](const FIntVector& QuantizedMin, const int32 Log2Size)
+			{
+				return IsSet(static_cast<int32>(EncodeMorton(QuantizedMin) - BinBase), 1 << (3 * Log2Size));
+			};
+
+			// Voxels are buffered and encoded in batches so the SIMD morton encoder can be used - the mask only learns about them
+			// as they are flushed, which at worst lets a block covered by the same shape be tested again
+			const auto FlushPendingVoxels = [&]()
+			{
+				if (PendingVoxels.IsEmpty())
+				{
+					return;
+				}
+
+				PendingCodes.SetNumUninitialized(PendingVoxels.Num(), EAllowShrinking::No);
+				EncodeMortonBatch(PendingVoxels, PendingCodes);
+				PendingVoxels.Reset();
+
+				for (const FMortonCode Code : PendingCodes)
+				{
+					const int32 Bit = static_cast<int32>(Code - BinBase);
+
+					if ((Occupied[Bit >> 6] & uint64(1) << (Bit & 63)) == 0)
+					{
+						Occupied[Bit >> 6] |= uint64(1) << (Bit & 63);
+						OutCodes.Add(Code);
+					}
+					else
+					{
+						++OutNumDuplicates;
+					}
+				}
+			};
+
+			const auto EncodeVoxel = [&](const FIntVector& WorldPosition)
+			{
+				PendingVoxels.Add(QuantizeVoxel<VoxelSize>(WorldPosition));
+				++OutNumEmitted;
+
+				if (PendingVoxels.Num() == EncodeBatchSize)
+				{
+					FlushPendingVoxels();
+				}
+			};
+
+			const auto EncodeBlock = [&](const FIntVector& QuantizedMin, const int32 Log2Size)
+			{
+				const FMortonCode BaseCode = EncodeMorton(QuantizedMin);
+				const int32 Begin = static_cast<int32>(BaseCode - BinBase);
+				const int32 Count = 1 << (3 * Log2Size);
+				OutNumEmitted += Count;
+
+				// A block of 2^N voxels per axis is exactly one node at level N - 1, its code is the shared prefix of the range
+				if (bSolidInterior && Log2Size > 0)
+				{
+					OutSolids.SetNum(FMath::Max(OutSolids.Num(), Log2Size));
+					OutSolids[Log2Size - 1].Add(BaseCode >> (3 * Log2Size));
+				}
+
+				const bool bEmitLeaves = !bSolidInterior || Log2Size == 0;
+
+				if (!bEmitLeaves && Count >= 64)
+				{
+					for (int32 Word = Begin >> 6; Word < (Begin + Count) >> 6; ++Word)
+					{
+						OutNumDuplicates += FMath::CountBits(Occupied[Word]);
+					}
+					
+					FMemory::Memset(Occupied.GetData() + (Begin >> 6), 0xFF, (Count >> 6) * sizeof(uint64));
+					return;
+				}
+
+				// Voxels another shape already emitted are left out
+				for (int32 Bit = Begin; Bit < Begin + Count; ++Bit)
+				{
+					uint64& Word = Occupied[Bit >> 6];
+					const uint64 Mask = uint64(1) << (Bit & 63);
+					
+					if ((Word & Mask) != 0)
+					{
+						++OutNumDuplicates;
+					}
+					else if (bEmitLeaves)
+					{
+						OutCodes.Add(BaseCode + (Bit - Begin));
+					}
+
+					Word |= Mask;
+				}
+			};
+
+			const FIntVector BinMin = DecodeMorton(BinBase);
+			const FIntVector BinMax = BinMin + FIntVector((1 << BinLog2Size) - 1);
+			PendingVoxels.Reserve(EncodeBatchSize);
+
+			for (const int32 ShapeIndex : Bin.Shapes)
+			{
+				const FShapeSet::FShape& Shape = ShapeSet->Shapes[ShapeIndex];
+				const FShapeSet::FComponent& Component = ShapeSet->Components[Shape.Component];
+
+				// Only the part of the shape inside the bin - the bounds map back to exactly that voxel range
+				FIntVector VoxelMin, VoxelMax;
+				GetVoxelRange<VoxelSize>(Shape.Bounds, VoxelMin, VoxelMax);
+				VoxelMin = FIntVector(FMath::Max(VoxelMin.X, BinMin.X), FMath::Max(VoxelMin.Y, BinMin.Y), FMath::Max(VoxelMin.Z, BinMin.Z));
+				VoxelMax = FIntVector(FMath::Min(VoxelMax.X, BinMax.X), FMath::Min(VoxelMax.Y, BinMax.Y), FMath::Min(VoxelMax.Z, BinMax.Z));
+				const FBox ClipBounds = GetVoxelRangeBounds<VoxelSize>(VoxelMin, VoxelMax);
+
+				switch (Shape.Type)
+				{
+				case FShapeSet::EShapeType::Box:
+					VoxelizeHierarchical<VoxelSize>(Component.BoxElems[Shape.Index], Component.Transform, ClipBounds, EncodeVoxel, EncodeBlock, IsBlockCovered);
+					break;
+				case FShapeSet::EShapeType::Sphere:
+					VoxelizeHierarchical<VoxelSize>(Component.SphereElems[Shape.Index], Component.Transform, ClipBounds, EncodeVoxel, EncodeBlock, IsBlockCovered);
+					break;
+				case FShapeSet::EShapeType::Sphyl:
+					VoxelizeHierarchical<VoxelSize>(Component.SphylElems[Shape.Index], Component.Transform, ClipBounds, EncodeVoxel, EncodeBlock, IsBlockCovered);
+					break;
+				case FShapeSet::EShapeType::Convex:
+					VoxelizeHierarchical<VoxelSize>(Component.ConvexElems[Shape.Index], Component.Transform, ClipBounds, EncodeVoxel, EncodeBlock, IsBlockCovered);
+					break;
+				case FShapeSet::EShapeType::Triangle:
+				{
+					const FVector* Vertices = &Component.TriangleVertices[3 * Shape.Index];
+					VoxelizeTriangle<VoxelSize>(Vertices[0], Vertices[1], Vertices[2], VoxelMin, VoxelMax, EncodeVoxel, IsBlockCovered);
+					break;
+				}
+				}
+
+				// The shapes after this one skip what it filled
+				FlushPendingVoxels();
+			}
+		}
+	};
+
+	/** Hands sorted bins out as contiguous runs in morton order, one voxelizer each, so every voxelizer returns a sorted run.
+	 *	Runs are cut by estimated voxel count rather than bin count, so a cluster of dense bins (one huge shape) spreads over several of them.
+	 */
+	template<int32 VoxelSize>
+	TArray<TBinVoxelizer<VoxelSize>> MakeBinVoxelizers(const TSharedPtr<const FShapeSet>& ShapeSet, TArray<FBin>&& Bins, const int32 NumRuns,
+		const bool bSolidInterior, const TSharedPtr<NavVolume::Stats::FVoxelizeCounters>& Counters)
+	{
+		int64 TotalVoxels = 0;
+
+		for (const FBin& Bin : Bins)
+		{
+			TotalVoxels += Bin.NumVoxels;
+		}
+
+		const int64 VoxelsPerRun = FMath::Max<int64>(1, FMath::DivideAndRoundUp<int64>(TotalVoxels, FMath::Max(1, NumRuns)));
+		TArray<TBinVoxelizer<VoxelSize>> Voxelizers;
+
+		for (int32 BinBegin = 0; BinBegin < Bins.Num();)
+		{
+			TBinVoxelizer<VoxelSize>& Voxelizer = Voxelizers.AddDefaulted_GetRef();
+			Voxelizer.ShapeSet = ShapeSet;
+			Voxelizer.bSolidInterior = bSolidInterior;
+			Voxelizer.Counters = Counters;
+
+			int64 RunVoxels = 0;
+
+			for (; BinBegin < Bins.Num() && RunVoxels < VoxelsPerRun; ++BinBegin)
+			{
+				RunVoxels += Bins[BinBegin].NumVoxels;
+				Voxelizer.Bins.Add(MoveTemp(Bins[BinBegin]));
+			}
+		}
+
+		return Voxelizers;
+	}
+} // namespace NavVolume::BroadPhase
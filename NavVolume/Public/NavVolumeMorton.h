@@ -32,4 +32,36 @@ namespace NavVolume::Morton
 	NAVVOLUME_API /** FORCEINLINE */ int32 DecodeMortonY(const FMortonCode Code);
 
 	NAVVOLUME_API /** FORCEINLINE */ int32 DecodeMortonZ(const FMortonCode Code);
+
+	/** Moves a code one step along an axis (0 = X, 1 = Y, 2 = Z) in a positive or negative direction.
+	 *	NumBits is the number of bits per axis in the code (e.g. less than 21 for the code of an octree node).
+	 *	Returns false, leaving OutCode untouched, if the coordinate would leave that range.
+	 */
+	NAVVOLUME_API bool StepMorton(const FMortonCode Code, const int32 Axis, const bool bPositive, FMortonCode& OutCode, const int32 NumBits = 21);
+
+	/** Implementations the batch functions can run - all of them give the same codes as EncodeMorton. */
+	enum class EMortonBatchPath : uint8
+	{
+		Scalar,
+		BMI2,
+		AVX2,
+	};
+
+	/** The path the batch functions pick on this CPU: BMI2 (PDEP/PEXT) where it is fast, AVX2 otherwise, then the scalar code.
+	 *	AMD CPUs before Zen 3 microcode PDEP and PEXT, which makes them several times slower than the scalar code - they use AVX2.
+	 */
+	NAVVOLUME_API EMortonBatchPath GetMortonBatchPath();
+
+	/** True if the CPU can run the path at all, fast or not. */
+	NAVVOLUME_API bool IsMortonBatchPathSupported(const EMortonBatchPath Path);
+
+	/** Encodes every point into the code at the same index - both views must be the same length. */
+	NAVVOLUME_API void EncodeMortonBatch(TArrayView<const FIntVector> Points, TArrayView<FMortonCode> Codes);
+
+	/** Decodes every code into the point at the same index - dispatched the same way as EncodeMortonBatch. */
+	NAVVOLUME_API void DecodeMortonBatch(TArrayView<const FMortonCode> Codes, TArrayView<FIntVector> Points);
+
+	/** EncodeMortonBatch and DecodeMortonBatch through a given path, e.g. to check each one against the scalar code - the path must be supported. */
+	NAVVOLUME_API void EncodeMortonBatch(const EMortonBatchPath Path, TArrayView<const FIntVector> Points, TArrayView<FMortonCode> Codes);
+	NAVVOLUME_API void DecodeMortonBatch(const EMortonBatchPath Path, TArrayView<const FMortonCode> Codes, TArrayView<FIntVector> Points);
 };
@@ -3,6 +3,12 @@
 #include "CoreMinimal.h"
 #include "NavVolumeMorton.h"
 #include "NavVolumeVoxel.h"
+#include "NavVolumeSort.h"
+#include "Algo/BinarySearch.h"
+#include "Async/ParallelFor.h"
+#include "Async/TaskGraphInterfaces.h"
+#include "Containers/StaticArray.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
 #include <bit>
 
 namespace NavVolume::Octree
@@ -10,13 +16,279 @@ namespace NavVolume::Octree
 	using namespace NavVolume::Morton;
 	using namespace NavVolume::Voxel;
 
-	template<int32 VoxelSize>
+	/** Input of an octree build - sorted unique morton codes of occupied leaf voxels, plus blocks already known to be solid.
+	 *	Solids[Level] holds the node codes (leaf code >> 3 * (Level + 1)) of blocks that become a single solid node at that level.
+	 */
+	struct FOctreeCodes
+	{
+		TArray<FMortonCode> Leaves;
+		TArray<TArray<FMortonCode>> Solids;
+
+		/** Merges sorted runs of leaves and solids (e.g. one per voxelizer) into a single sorted unique set. */
+		static FOctreeCodes Merge(TArray<FOctreeCodes>&& Runs)
+		{
+			TRACE_CPUPROFILER_EVENT_SCOPE(NavVolume::MergeCodes);
+			
+			TArray<TArray<FMortonCode>> LeafRuns;
+			TArray<TArray<TArray<FMortonCode>>> SolidRuns;
+			LeafRuns.Reserve(Runs.Num());
+
+			for (FOctreeCodes& Run : Runs)
+			{
+				LeafRuns.Add(MoveTemp(Run.Leaves));
+				SolidRuns.SetNum(FMath::Max(SolidRuns.Num(), Run.Solids.Num()));
+
+				for (int32 Level = 0; Level < Run.Solids.Num(); ++Level)
+				{
+					SolidRuns[Level].Add(MoveTemp(Run.Solids[Level]));
+				}
+			}
+
+			FOctreeCodes Merged;
+			Merged.Leaves = NavVolume::Sort::MergeUnique(MoveTemp(LeafRuns));
+			Merged.Solids.SetNum(SolidRuns.Num());
+
+			for (int32 Level = 0; Level < SolidRuns.Num(); ++Level)
+			{
+				Merged.Solids[Level] = NavVolume::Sort::MergeUnique(MoveTemp(SolidRuns[Level]));
+			}
+			
+			return Merged;
+		}
+
+		/** Replaces everything inside a region with codes voxelized for just that region, everything outside it is kept.
+		 *	The region is a sorted set of aligned cubes of 2^Log2Size voxels given by their minimum leaf code - each cube is one contiguous
+		 *	range of leaf codes, so what lies inside is found by binary search instead of a spatial test.
+		 */
+		FOctreeCodes Splice(TConstArrayView<FMortonCode> RegionCodes, const int32 Log2Size, FOctreeCodes&& RegionVoxels) const
+		{
+			TRACE_CPUPROFILER_EVENT_SCOPE(NavVolume::SpliceCodes);
+			check(Log2Size > 0);
+			const FMortonCode RangeSize = FMortonCode(1) << (3 * Log2Size);
+
+			// True if any cube covers part of the leaf codes [Begin, End)
+			const auto Overlaps = [&RegionCodes, RangeSize](const FMortonCode Begin, const FMortonCode End)
+			{
+				const int32 Index = Algo::UpperBound(RegionCodes, Begin) - 1;
+				return (Index >= 0 && RegionCodes[Index] + RangeSize > Begin) || (Index + 1 < RegionCodes.Num() && RegionCodes[Index + 1] < End);
+			};
+
+			FOctreeCodes Kept;
+			Kept.Leaves.Reserve(Leaves.Num());
+			Kept.Solids.SetNum(Solids.Num());
+
+			for (const FMortonCode Leaf : Leaves)
+			{
+				if (!Overlaps(Leaf, Leaf + 1))
+				{
+					Kept.Leaves.Add(Leaf);
+				}
+			}
+
+			// A block no larger than a cube is either inside one or outside all of them, larger blocks are split until that holds
+			const auto KeepSolid = [&Kept, &Overlaps, Log2Size](const auto& Self, const int32 Level, const FMortonCode Code) -> void
+			{
+				const int32 Shift = 3 * (Level + 1);
+
+				if (!Overlaps(Code << Shift, (Code + 1) << Shift))
+				{
+					Kept.Solids[Level].Add(Code);
+				}
+				else if (Level + 1 > Log2Size)
+				{
+					for (int32 Octant = 0; Octant < 8; ++Octant)
+					{
+						Self(Self, Level - 1, Code << 3 | Octant);
+					}
+				}
+			};
+
+			for (int32 Level = 0; Level < Solids.Num(); ++Level)
+			{
+				for (const FMortonCode Code : Solids[Level])
+				{
+					KeepSolid(KeepSolid, Level, Code);
+				}
+			}
+
+			// Split blocks are appended out of order
+			for (TArray<FMortonCode>& LevelCodes : Kept.Solids)
+			{
+				NavVolume::Sort::SortUnique(LevelCodes);
+			}
+
+			TArray<FOctreeCodes> Runs;
+			Runs.Add(MoveTemp(Kept));
+			Runs.Add(MoveTemp(RegionVoxels));
+			return Merge(MoveTemp(Runs));
+		}
+
+		/** Grows a set of leaf voxels by Radius voxels along every axis - a box dilation, so everything within Radius of a leaf on each
+		 *	axis becomes occupied. Done as one pass per axis, each emitting 2 * Radius + 1 codes per leaf before removing duplicates, rather than
+		 *	the (2 * Radius + 1)^3 codes of the whole box. The result is sorted and unique.
+		 */
+		static void DilateLeaves(TArray<FMortonCode>& InOutLeaves, const int32 Radius)
+		{
+			TRACE_CPUPROFILER_EVENT_SCOPE(NavVolume::DilateLeaves);
+			NavVolume::Sort::SortUnique(InOutLeaves);
+
+			TArray<FMortonCode> Grown;
+
+			for (int32 Axis = 0; Axis < 3 && Radius > 0; ++Axis)
+			{
+				Grown.Reset(InOutLeaves.Num() * (2 * Radius + 1));
+
+				for (const FMortonCode Leaf : InOutLeaves)
+				{
+					Grown.Add(Leaf);
+
+					for (const bool bPositive : { false, true })
+					{
+						FMortonCode Code = Leaf;
+						for (int32 Step = 0; Step < Radius && StepMorton(Code, Axis, bPositive, Code); ++Step) Grown.Add(Code);
+					}
+				}
+
+				NavVolume::Sort::SortUnique(Grown);
+				Swap(InOutLeaves, Grown);
+			}
+		}
+
+		SIZE_T GetAllocatedSize() const
+		{
+			SIZE_T AllocatedSize = Leaves.GetAllocatedSize() + Solids.GetAllocatedSize();
+			for (const TArray<FMortonCode>& Level : Solids) AllocatedSize += Level.GetAllocatedSize();
+			return AllocatedSize;
+		}
+
+		friend FArchive& operator<<(FArchive& Ar, FOctreeCodes& Codes)
+		{
+			Codes.Leaves.BulkSerialize(Ar);
+
+			int32 NumLevels = Codes.Solids.Num();
+			Ar << NumLevels;
+			if (Ar.IsLoading()) Codes.Solids.SetNum(NumLevels);
+
+			for (TArray<FMortonCode>& Level : Codes.Solids)
+			{
+				Level.BulkSerialize(Ar);
+			}
+
+			return Ar;
+		}
+	};
+
+	/** Packed reference to an element of a TSparseVoxelOctree, the target of a neighbour link.
+	 *	Level -1 is the leaves. The subnode is the empty octant of a node, or the voxel of a brick.
+	 *	The tile is only used by tiled octrees (see NavVolumeTiles.h) to tell which tile's octree the rest refers to.
+	 */
+	struct FNodeLink
+	{
+		enum class EType : uint8
+		{
+			Invalid,	// Outside the octree
+			Node,		// An existing node or leaf - solid, or a parent whose children may be finer than the link's origin
+			Octant,		// An empty octant of a node - free space the size of the node's children
+			Voxel,		// A single voxel of a brick with BrickLeaves
+			Tile,		// A whole tile without geometry, only used by tiled octrees - such tiles aren't stored, the link holds the tile's key
+		};
+
+		static constexpr int32 MaxNumTiles = 1 << 18;
+
+		/** Keys of tiles up to 2^14 per axis fit below the type. */
+		static constexpr int32 TileKeyBits = 43;
+
+		static constexpr int32 LeafLevel = -1;
+
+		uint64 Packed = 0;
+
+		static FORCEINLINE FNodeLink Make(const EType Type, const int32 Level, const int32 Index, const int32 Subnode = 0)
+		{
+			FNodeLink Link;
+			Link.Packed = uint64(uint32(Index)) | uint64(Subnode & 63) << 32 | uint64(Level + 1) << 38 | uint64(Type) << 43;
+			return Link;
+		}
+
+		FORCEINLINE EType GetType() const { return static_cast<EType>(Packed >> 43 & 7); }
+		FORCEINLINE int32 GetLevel() const { return static_cast<int32>(Packed >> 38 & 31) - 1; }
+		FORCEINLINE int32 GetIndex() const { return static_cast<int32>(Packed & 0xFFFFFFFF); }
+		FORCEINLINE int32 GetSubnode() const { return static_cast<int32>(Packed >> 32 & 63); }
+		FORCEINLINE int32 GetTile() const { return static_cast<int32>(Packed >> 46); }
+		FORCEINLINE bool IsValid() const { return GetType() != EType::Invalid; }
+
+		static FORCEINLINE FNodeLink MakeTile(const uint64 TileKey)
+		{
+			check(TileKey < uint64(1) << TileKeyBits);
+			FNodeLink Link;
+			Link.Packed = TileKey | uint64(EType::Tile) << 43;
+			return Link;
+		}
+
+		FORCEINLINE uint64 GetTileKey() const { return Packed & ((uint64(1) << TileKeyBits) - 1); }
+
+		FORCEINLINE FNodeLink WithTile(const int32 Tile) const
+		{
+			check(Tile >= 0 && Tile < MaxNumTiles);
+			FNodeLink Link;
+			Link.Packed = (Packed & ((uint64(1) << 46) - 1)) | uint64(Tile) << 46;
+			return Link;
+		}
+
+		FORCEINLINE bool operator==(const FNodeLink& Other) const { return Packed == Other.Packed; }
+		FORCEINLINE bool operator!=(const FNodeLink& Other) const { return Packed != Other.Packed; }
+		friend FORCEINLINE uint32 GetTypeHash(const FNodeLink& Link) { return ::GetTypeHash(Link.Packed); }
+		friend FORCEINLINE FArchive& operator<<(FArchive& Ar, FNodeLink& Link) { return Ar << Link.Packed; }
+	};
+
+	/** Optional layouts of TSparseVoxelOctree. */
+	enum class EOctreeLayout : uint8
+	{
+		None = 0,
+		
+		/** Leaves are 4x4x4 voxel bricks, each stored as a 64-bit occupancy mask, instead of one morton code per voxel.
+		 *	Level 0 then starts at 8x8x8 voxels as the bricks take the place of the two lowest levels.
+		 */
+		BrickLeaves = 1 << 0,
+
+		/** Every level keeps the morton code of each node so position, bounds and codes of a node are found in constant time
+		 *	instead of following FirstChildIndex down to a leaf. Costs 8 bytes per node.
+		 */
+		LevelCodes = 1 << 1,
+
+		/** Every node (and brick with BrickLeaves) links to its 6 face neighbours of the same size or larger, built after the levels.
+		 *	Makes adjacency queries constant time for pathfinding instead of a search per step. Costs 48 bytes per node.
+		 */
+		NeighbourLinks = 1 << 2,
+	};
+	ENUM_CLASS_FLAGS(EOctreeLayout);
+
+	template<int32 VoxelSize, EOctreeLayout Layout = EOctreeLayout::None>
 	struct NAVVOLUME_API TSparseVoxelOctree 
 	{
+		static constexpr bool bBrickLeaves = EnumHasAnyFlags(Layout, EOctreeLayout::BrickLeaves);
+		static constexpr bool bLevelCodes = EnumHasAnyFlags(Layout, EOctreeLayout::LevelCodes);
+		static constexpr bool bNeighbourLinks = EnumHasAnyFlags(Layout, EOctreeLayout::NeighbourLinks);
+
+		/** Face directions of a neighbour link - the axis is Direction / 2, odd directions are positive (-X, +X, -Y, +Y, -Z, +Z). */
+		static constexpr int32 NumDirections = 6;
+
+		/** Size of a leaf as a power of 2 voxels per axis (1 voxel or a 4x4x4 brick). */
+		static constexpr int32 LeafLog2Size = bBrickLeaves ? 2 : 0;
+
+		/** A full brick - every voxel is occupied. */
+		static constexpr uint64 SolidBrick = MAX_uint64;
+		
+		/** A node as read from (or built for) the flat node arrays - see GetNode. */
 		struct FNode
 		{
 			int32 FirstChildIndex = INDEX_NONE;
 			uint8 ChildBitMask = 0;
+
+			/** A solid node is fully occupied and has no children - FirstChildIndex is the index of its code in Solids instead. */
+			FORCEINLINE bool IsSolid() const
+			{
+				return ChildBitMask == 0;
+			}
 		};
 
 		struct FNodeLocation
@@ -26,36 +298,69 @@ namespace NavVolume::Octree
 		};
 
 		typedef TArray<FMortonCode> FLeaves;
-		typedef TArray<FNode> FLevel;
-		typedef TArray<FLevel> FLevels;
+		typedef TArray<uint64> FBricks;
+		typedef TArray<FNode> FLevel; // A level while it is built, before it is appended to the flat node arrays
+		typedef TStaticArray<FNodeLink, NumDirections> FNodeLinks;
+
+		/** Shift from a node code at the level (or the leaves at FNodeLink::LeafLevel) to the morton code of its minimum voxel. */
+		static constexpr int32 GetLevelShift(const int32 Level)
+		{
+			return 3 * (Level + 1 + LeafLog2Size);
+		}
 		
+		/** An empty octree, e.g. to load one into with Serialize. */
+		TSparseVoxelOctree() = default;
+
 		TSparseVoxelOctree(TArray<FMortonCode>&& InCodes)
+			: TSparseVoxelOctree(FOctreeCodes { MoveTemp(InCodes) }, false) { }
+
+		/** Builds the octree from leaf codes and solid blocks.
+		 *	With bCollapseSolids a node whose 8 children are all solid (or occupied leaves) replaces them as a single solid node,
+		 *	so a filled volume only costs roughly its surface.
+		 *	MinNumLevels keeps adding levels above a single root, e.g. so the root of a tile always covers the whole tile.
+		 *	Without bParallel every level is built in one serial scan - the reference the chunked build is compared against.
+		 */
+		TSparseVoxelOctree(FOctreeCodes&& InCodes, const bool bCollapseSolids, const int32 MinNumLevels = 0, const bool bParallel = true)
 		{
-			TArray<FMortonCode> ItrCodes = MoveTemp(InCodes);
+			TRACE_CPUPROFILER_EVENT_SCOPE(NavVolume::BuildOctree);
+			
+			FOctreeCodes Codes = MoveTemp(InCodes);
+			RemoveCoveredCodes(Codes);
+			
+			TArray<FMortonCode> ItrCodes = MoveTemp(Codes.Leaves);
 			TArray<FMortonCode> CurCodes;
 
-			constexpr int32 MaxNumLevels = 21; // 21-bits per axis
+			if constexpr (bBrickLeaves)
+			{
+				TRACE_CPUPROFILER_EVENT_SCOPE(NavVolume::BuildBricks);
+				BuildBricks(ItrCodes, Codes);
+			}
+
+			constexpr int32 MaxNumLevels = 21 - LeafLog2Size; // 21-bits per axis
+
+			// Only the level being built and the one below it are kept apart - every level below is final and already flattened
+			FLevel ItrLevel;
+			FLevel CurLevel;
 			
 			for (int32 LevelIndex = 0; LevelIndex < MaxNumLevels; ++LevelIndex)
 			{
-				FLevel& CurLevel = Levels.InsertDefaulted_GetRef(LevelIndex); 
+				TRACE_CPUPROFILER_EVENT_SCOPE(NavVolume::BuildOctreeLevel);
+				
+				const bool bAboveLeaves = LevelIndex == 0; // ItrLevel is empty when the layer below is the leaves
+				BuildLevel(ItrCodes, ItrLevel, bAboveLeaves, bCollapseSolids, bParallel, CurCodes, CurLevel);
 
-				for (int32 ItrIndex = 0; ItrIndex < ItrCodes.Num(); ++ItrIndex)
+				// The layer below is final once collapsed children are removed
+				if (!bAboveLeaves)
 				{
-					const FMortonCode ItrCode = ItrCodes[ItrIndex];
-					const FMortonCode CurCode = ItrCode >> 3; 
+					FinalizeLevel(ItrLevel, ItrCodes);
+				}
 
-					// Shifting 3-bits of a code can produce up to 8 of the same code (e.g. 1 node with 1-8 octants)
-					// For every unique code encountered create a new node and save the code for next level construction
-					if (CurCodes.IsEmpty() || CurCodes.Last() != CurCode)
-					{
-						FNode CurNode { ItrIndex };
-						CurCodes.Add(CurCode);
-						CurLevel.Add(CurNode);
-					}
+				// Solid blocks are indexed by their size - a leaf isn't always a single voxel
+				const int32 SolidLevel = LevelIndex + LeafLog2Size;
 
-					// The last 3-bits of a code represent the relative octant
-					CurLevel.Last().ChildBitMask |= 1 << (ItrCode & 7);
+				if (Codes.Solids.IsValidIndex(SolidLevel))
+				{
+					MergeSolids(CurCodes, CurLevel, Codes.Solids[SolidLevel]);
 				}
 				
 				if (LevelIndex == 0)
@@ -64,12 +369,23 @@ namespace NavVolume::Octree
 				}
 				
 				ItrCodes = MoveTemp(CurCodes);
-				
-				if (ItrCodes.Num() <= 1)
+				ItrLevel = MoveTemp(CurLevel);
+
+				// A single root is only the top if no solid blocks are still waiting to join at a higher level
+				if (ItrCodes.Num() <= 1 && !HasSolidsAbove(Codes, SolidLevel) && LevelIndex + 1 >= MinNumLevels)
 				{
-					return;
+					break;
 				}
 			}
+
+			FinalizeLevel(ItrLevel, ItrCodes);
+			ShrinkLevels();
+
+			if constexpr (bNeighbourLinks)
+			{
+				TRACE_CPUPROFILER_EVENT_SCOPE(NavVolume::BuildNeighbourLinks);
+				BuildNeighbourLinks();
+			}
 		}
 
 		FORCEINLINE FMortonCode GetMortonCode(FNode Node, const int32 Level) const
@@ -78,81 +394,1131 @@ namespace NavVolume::Octree
 			
 			int32 ItrLevel = Level;
 			
-			// Follow the parent-child chain until at the last node before a leaf
-			while (ItrLevel > 0)
-				Node = Levels[--ItrLevel][Node.FirstChildIndex];
+			// Follow the parent-child chain until at the last node before a leaf, or at a solid node which knows its own code
+			while (ItrLevel > 0 && !Node.IsSolid())
+				Node = GetNode(--ItrLevel, Node.FirstChildIndex);
 
 			// 64-bits set to 1 - can't just right shift as that skews the XYZ coordinates
 			constexpr uint64 LevelMask = 0xFFFFFFFFFFFFFFFF;
+
+			if (Node.IsSolid())
+			{
+				return Solids[Node.FirstChildIndex] << GetLevelShift(ItrLevel) & LevelMask << GetLevelShift(Level);
+			}
 			
 			// Access the morton code at the leaf - set 3-bits to 0 for each level
-			return Leaves[Node.FirstChildIndex] & LevelMask << (3 * (Level + 1));
+			return GetLeafCode(Node.FirstChildIndex) & LevelMask << GetLevelShift(Level);
+		}
+
+		/** Morton code of the minimum voxel of a node - constant time with LevelCodes, otherwise found by walking down to a leaf. */
+		FORCEINLINE FMortonCode GetMortonCode(const FNodeLocation Location) const
+		{
+			if constexpr (bLevelCodes)
+			{
+				return LevelCodes[GetNodeOffset(Location.Level) + Location.NodeIndex] << GetLevelShift(Location.Level);
+			}
+			
+			return GetMortonCode(GetNode(Location.Level, Location.NodeIndex), Location.Level);
+		}
+
+		/** Morton code of the minimum voxel of a leaf. */
+		FORCEINLINE FMortonCode GetLeafCode(const int32 LeafIndex) const
+		{
+			return Leaves[LeafIndex] << (3 * LeafLog2Size);
 		}
 
 		FORCEINLINE FIntVector GetPosition(const FNode Node, const int32 Level) const
 		{
 			const FMortonCode MortonCode = GetMortonCode(Node, Level);
-			const int32 CenterOffset = TVoxelTraits<VoxelSize>::HalfVoxelSize * ((2 << Level) - 1); // (2^(n+1)) - 1 where n>0
+			const int32 CenterOffset = TVoxelTraits<VoxelSize>::HalfVoxelSize * ((2 << (Level + LeafLog2Size)) - 1); // (2^(n+1)) - 1 where n>0
+			return DequantizeVoxel<VoxelSize>(DecodeMorton(MortonCode)) + FIntVector(CenterOffset);
+		}
+
+		FORCEINLINE FIntVector GetPosition(const FNodeLocation Location) const
+		{
+			const FMortonCode MortonCode = GetMortonCode(Location);
+			const int32 CenterOffset = TVoxelTraits<VoxelSize>::HalfVoxelSize * ((2 << (Location.Level + LeafLog2Size)) - 1);
 			return DequantizeVoxel<VoxelSize>(DecodeMorton(MortonCode)) + FIntVector(CenterOffset);
 		}
 
+		FORCEINLINE FBox GetBounds(const FNodeLocation Location) const
+		{
+			return FBox::BuildAABB(FVector(GetPosition(Location)), FVector(GetHalfSize(Location.Level)));
+		}
+
 		FORCEINLINE int32 GetHalfSize(const int32 Level) const
 		{
 			check(Level >= 0 && Level < NumLevels());
-			return TVoxelTraits<VoxelSize>::HalfVoxelSize * (2 << Level); // (2^(n+1)) where n>0
+			return TVoxelTraits<VoxelSize>::HalfVoxelSize * (2 << (Level + LeafLog2Size)); // (2^(n+1)) where n>0
 		}
 
 		FORCEINLINE int32 NumLevels() const
 		{
-			return Levels.Num();
+			return FMath::Max(LevelOffsets.Num() - 1, 0);
+		}
+
+		FORCEINLINE int32 NumNodes(const int32 Level) const
+		{
+			return LevelOffsets[Level + 1] - LevelOffsets[Level];
+		}
+
+		FORCEINLINE int32 NumSolids(const int32 Level) const
+		{
+			return SolidOffsets[Level + 1] - SolidOffsets[Level];
+		}
+
+		/** Index of the first node of a level in the flat node arrays (and LevelCodes and Links). */
+		FORCEINLINE int32 GetNodeOffset(const int32 Level) const
+		{
+			return LevelOffsets[Level];
+		}
+
+		FORCEINLINE FNode GetNode(const int32 Level, const int32 NodeIndex) const
+		{
+			const int32 Index = LevelOffsets[Level] + NodeIndex;
+			return FNode { FirstChildIndices[Index], ChildBitMasks[Index] };
 		}
 		
 		FORCEINLINE bool HasChild(const FNode Node, const uint8 RelativeOctant) const
 		{
-			// Interval [1, 8]
-			check(RelativeOctant < 9 && RelativeOctant > 0);
+			// Interval [0, 7] - the low 3 bits of the child's code
+			check(RelativeOctant < 8);
 			return Node.ChildBitMask & (1 << RelativeOctant);
 		}
 		
 		FORCEINLINE int32 ChildIndex(const FNode Node, const uint8 RelativeOctant) const
 		{
 			check(HasChild(Node, RelativeOctant));
-			const uint8 LowerBits = Node.ChildBitMask & (0xFF >> (9 - RelativeOctant));
+			const uint8 LowerBits = Node.ChildBitMask & ((1 << RelativeOctant) - 1);
 			return Node.FirstChildIndex + std::popcount<uint8>(LowerBits);
 		}
 
-		void DebugDrawLevel(const UWorld* World, const int32 Level, const FColor Color) const
+		/** Link to the neighbour of a node, leaf brick, empty octant or brick voxel across one of its faces.
+		 *	The neighbour is the same size or larger - a Node link with children means the far side is finer and has to be descended.
+		 *	Constant time, requires NeighbourLinks.
+		 */
+		FNodeLink GetNeighbour(const FNodeLink Link, const int32 Direction) const
 		{
-#if WITH_EDITOR
-			const FLevel& CurLevel = Levels[Level];
+			check(bNeighbourLinks && Direction >= 0 && Direction < NumDirections);
+
+			const int32 Level = Link.GetLevel();
+			const int32 Index = Link.GetIndex();
+			const int32 AxisBit = 1 << (Direction / 2);
+			const bool bPositive = Direction & 1;
 
-			for (const FNode& Node : CurLevel)
+			switch (Link.GetType())
 			{
-				const FVector Center = FVector(GetPosition(Node, Level));
-				const FVector Extent = FVector(GetHalfSize(Level)); 
-				DrawDebugBox(World, Center, Extent, FQuat::Identity, Color, true);
+			case FNodeLink::EType::Node:
+				if (Level != FNodeLink::LeafLevel) return Links[GetNodeOffset(Level) + Index][Direction];
+				if constexpr (bBrickLeaves) return LeafLinks[Index][Direction];
+				return FNodeLink(); // A single voxel leaf is always blocked
+				
+			case FNodeLink::EType::Octant:
+			{
+				const int32 Octant = Link.GetSubnode() ^ AxisBit;
+
+				// Still inside the same node
+				if (((Link.GetSubnode() & AxisBit) == 0) == bPositive)
+				{
+					return GetOctantLink(Level, Index, Octant);
+				}
+
+				// The neighbour across the face is only subdivided further if it is the same size as the node
+				const FNodeLink Neighbour = Links[GetNodeOffset(Level) + Index][Direction];
+				const bool bSameSize = Neighbour.GetType() == FNodeLink::EType::Node && Neighbour.GetLevel() == Level;
+				return bSameSize ? GetOctantLink(Level, Neighbour.GetIndex(), Octant) : Neighbour;
 			}
-#endif // WITH_EDITOR
+				
+			case FNodeLink::EType::Voxel:
+				if constexpr (bBrickLeaves)
+				{
+					// A brick is a 2-bit per axis morton code
+					FMortonCode Voxel;
+					
+					if (StepMorton(Link.GetSubnode(), Direction / 2, bPositive, Voxel, 2))
+					{
+						return FNodeLink::Make(FNodeLink::EType::Voxel, FNodeLink::LeafLevel, Index, static_cast<int32>(Voxel));
+					}
+
+					const FNodeLink Neighbour = LeafLinks[Index][Direction];
+
+					if (Neighbour.GetType() == FNodeLink::EType::Node && Neighbour.GetLevel() == FNodeLink::LeafLevel)
+					{
+						// Wrap around to the opposite face of the next brick
+						const int32 AxisMask = 0b001001 << (Direction / 2);
+						const int32 Wrapped = (Link.GetSubnode() & ~AxisMask) | (bPositive ? 0 : AxisMask);
+						return FNodeLink::Make(FNodeLink::EType::Voxel, FNodeLink::LeafLevel, Neighbour.GetIndex(), Wrapped);
+					}
+					
+					return Neighbour;
+				}
+				break;
+				
+			default:
+				break;
+			}
+
+			return FNodeLink();
 		}
 
-		void DebugDraw(const UWorld* World, const FColor Color1 = FColor::Red, const FColor Color2 = FColor::Green) const
+		/** Link to an octant of a node - the child if it exists, the node itself if solid, otherwise the empty octant. */
+		FORCEINLINE FNodeLink GetOctantLink(const int32 Level, const int32 NodeIndex, const int32 Octant) const
 		{
-#if WITH_EDITOR
-			for (const FMortonCode& Code : Leaves)
+			const FNode Node = GetNode(Level, NodeIndex);
+
+			if (Node.IsSolid())
 			{
-				const FVector Center = FVector(DequantizeVoxel<VoxelSize>(DecodeMorton(Code)));
-				const FVector Extent = FVector(TVoxelTraits<VoxelSize>::HalfVoxelSize);
-				DrawDebugBox(World, Center, Extent, FQuat::Identity, Color1, true);
+				return FNodeLink::Make(FNodeLink::EType::Node, Level, NodeIndex);
 			}
 
-			for (int32 Level = 0; Level < NumLevels(); ++Level)
+			if (HasChild(Node, Octant))
 			{
-				DebugDrawLevel(World, Level, Level % 2 == 0 ? Color2 : Color1);
+				return FNodeLink::Make(FNodeLink::EType::Node, Level - 1, ChildIndex(Node, Octant));
+			}
+
+			return FNodeLink::Make(FNodeLink::EType::Octant, Level, NodeIndex, Octant);
+		}
+
+		/** Finds the smallest element that contains a world position - an empty octant, a solid node or a brick voxel.
+		 *	Invalid when outside the octree.
+		 */
+		FORCEINLINE FNodeLink FindLink(const FVector& Position) const
+		{
+			return FindLinkAtCode(EncodeMorton(SnapToVoxelAxis<VoxelSize>(Position) / VoxelSize));
+		}
+
+		/** Finds the smallest element that contains a cell of 2^Log2Size voxels given by its minimum leaf code, without going below the
+		 *	size of the cell - a node the size of the cell is returned as is even if it has children.
+		 */
+		FNodeLink FindLinkAtCode(const FMortonCode Code, const int32 Log2Size = 0) const
+		{
+			int32 Level = NumLevels() - 1;
+			int32 NodeIndex = INDEX_NONE;
+
+			// The top level is normally a single root
+			for (int32 RootIndex = 0; Level >= 0 && RootIndex < NumNodes(Level); ++RootIndex)
+			{
+				if (GetMortonCode(FNodeLocation { Level, RootIndex }) >> GetLevelShift(Level) == Code >> GetLevelShift(Level))
+				{
+					NodeIndex = RootIndex;
+					break;
+				}
+			}
+
+			if (NodeIndex == INDEX_NONE)
+			{
+				return FNodeLink();
+			}
+
+			while (true)
+			{
+				if (GetLevelShift(Level) / 3 <= Log2Size)
+				{
+					return FNodeLink::Make(FNodeLink::EType::Node, Level, NodeIndex);
+				}
+				
+				const int32 Octant = Code >> (GetLevelShift(Level) - 3) & 7;
+				const FNodeLink Link = GetOctantLink(Level, NodeIndex, Octant);
+				
+				if (Link.GetType() != FNodeLink::EType::Node || Link.GetLevel() == Level)
+				{
+					return Link;
+				}
+
+				if (Link.GetLevel() == FNodeLink::LeafLevel)
+				{
+					if constexpr (bBrickLeaves)
+					{
+						if (Log2Size >= LeafLog2Size) return Link;
+						return FNodeLink::Make(FNodeLink::EType::Voxel, FNodeLink::LeafLevel, Link.GetIndex(), static_cast<int32>(Code & 63));
+					}
+					
+					return Link;
+				}
+
+				Level = Link.GetLevel();
+				NodeIndex = Link.GetIndex();
+			}
+		}
+
+		/** True if the element of a link is empty space - an empty octant, or an unoccupied brick voxel. */
+		FORCEINLINE bool IsLinkFree(const FNodeLink Link) const
+		{
+			switch (Link.GetType())
+			{
+			case FNodeLink::EType::Octant:
+				return true;
+			case FNodeLink::EType::Voxel:
+				return (Bricks[Link.GetIndex()] & uint64(1) << Link.GetSubnode()) == 0;
+			default:
+				return false;
+			}
+		}
+
+		/** Morton code of the minimum voxel of the element of a link, and its size as a power of 2 voxels per axis. */
+		FORCEINLINE void GetLinkCell(const FNodeLink Link, FMortonCode& OutCode, int32& OutLog2Size) const
+		{
+			const int32 Level = Link.GetLevel();
+			const FMortonCode Code = Level == FNodeLink::LeafLevel ? GetLeafCode(Link.GetIndex()) : GetMortonCode(FNodeLocation { Level, Link.GetIndex() });
+			
+			switch (Link.GetType())
+			{
+			case FNodeLink::EType::Octant:
+				OutLog2Size = GetLevelShift(Level) / 3 - 1;
+				OutCode = Code | FMortonCode(Link.GetSubnode()) << (3 * OutLog2Size);
+				break;
+			case FNodeLink::EType::Voxel:
+				OutLog2Size = 0;
+				OutCode = Code | Link.GetSubnode();
+				break;
+			default:
+				OutLog2Size = GetLevelShift(Level) / 3;
+				OutCode = Code;
+				break;
+			}
+		}
+
+		FORCEINLINE FBox GetLinkBounds(const FNodeLink Link) const
+		{
+			FMortonCode Code;
+			int32 Log2Size;
+			GetLinkCell(Link, Code, Log2Size);
+			return GetCellBounds(Code, Log2Size);
+		}
+
+		/** World bounds of a cell of 2^Log2Size voxels per axis given by its minimum leaf code. */
+		static FORCEINLINE FBox GetCellBounds(const FMortonCode Code, const int32 Log2Size)
+		{
+			const int32 HalfSize = TVoxelTraits<VoxelSize>::HalfVoxelSize << Log2Size;
+			const FVector Center = FVector(DequantizeVoxel<VoxelSize>(DecodeMorton(Code))) + FVector(HalfSize - TVoxelTraits<VoxelSize>::HalfVoxelSize);
+			return FBox::BuildAABB(Center, FVector(HalfSize));
+		}
+
+		/** Collects the free elements that touch the face of an element in Direction. */
+		FORCEINLINE void CollectFreeNeighbours(const FNodeLink Link, const int32 Direction, TArray<FNodeLink>& OutLinks) const
+		{
+			CollectFreeFace(GetNeighbour(Link, Direction), Direction, OutLinks);
+		}
+
+		/** Collects the free elements of a neighbour that touch the face crossed in Direction - a subdivided neighbour is descended
+		 *	through the 4 octants (or 16 brick voxels) on the near side only.
+		 */
+		void CollectFreeFace(const FNodeLink Link, const int32 Direction, TArray<FNodeLink>& OutLinks) const
+		{
+			if (IsLinkFree(Link))
+			{
+				OutLinks.Add(Link);
+				return;
+			}
+
+			if (Link.GetType() != FNodeLink::EType::Node)
+			{
+				return;
+			}
+
+			const int32 Axis = Direction / 2;
+			const bool bPositive = Direction & 1;
+			const int32 Level = Link.GetLevel();
+
+			if (Level == FNodeLink::LeafLevel)
+			{
+				if constexpr (bBrickLeaves)
+				{
+					// Coordinate along the axis within the brick - bits Axis and Axis + 3 of the voxel index
+					const int32 FaceCoordinate = bPositive ? 0 : 3;
+
+					for (int32 Voxel = 0; Voxel < 64; ++Voxel)
+					{
+						if (((Voxel >> Axis & 1) | (Voxel >> (Axis + 3) & 1) << 1) == FaceCoordinate)
+						{
+							const FNodeLink VoxelLink = FNodeLink::Make(FNodeLink::EType::Voxel, FNodeLink::LeafLevel, Link.GetIndex(), Voxel);
+							if (IsLinkFree(VoxelLink)) OutLinks.Add(VoxelLink);
+						}
+					}
+				}
+
+				return;
+			}
+
+			if (GetNode(Level, Link.GetIndex()).IsSolid())
+			{
+				return;
+			}
+
+			for (int32 Octant = 0; Octant < 8; ++Octant)
+			{
+				if (((Octant >> Axis & 1) == 0) == bPositive)
+				{
+					CollectFreeFace(GetOctantLink(Level, Link.GetIndex(), Octant), Direction, OutLinks);
+				}
+			}
+		}
+
+		/** Finds where a segment first enters an occupied voxel, as a fraction of the segment - false if it is clear.
+		 *	Nodes are descended front to back, empty octants are skipped whole through ChildBitMask and bricks are walked through their
+		 *	occupancy mask, so open space costs a few nodes per level rather than a step per voxel.
+		 */
+		FORCEINLINE bool Raycast(const FVector& Start, const FVector& End, double& OutTime) const
+		{
+			return Raycast(FVoxelRay::Make<VoxelSize>(Start, End), OutTime);
+		}
+
+		bool Raycast(const FVoxelRay& Ray, double& OutTime) const
+		{
+			struct FEntry
+			{
+				int32 Level; // FNodeLink::LeafLevel for a leaf
+				int32 Index;
+				FIntVector VoxelMin;
+				double Time;
+			};
+			
+			TArray<FEntry, TInlineAllocator<128>> Stack;
+			const int32 TopLevel = NumLevels() - 1;
+
+			// Roots are disjoint so the order they are entered in is the order they are passed through
+			for (int32 RootIndex = 0; RootIndex < (TopLevel >= 0 ? NumNodes(TopLevel) : 0); ++RootIndex)
+			{
+				const FIntVector VoxelMin = DecodeMorton(GetMortonCode(FNodeLocation { TopLevel, RootIndex }));
+				double Time;
+
+				if (Ray.Intersects(VoxelMin, GetLevelShift(TopLevel) / 3, Time))
+				{
+					Stack.Add(FEntry { TopLevel, RootIndex, VoxelMin, Time });
+				}
+			}
+
+			Stack.Sort([](const FEntry& A, const FEntry& B) { return A.Time > B.Time; });
+			
+			// Depth first with every child list pushed back to front, so the first occupied voxel popped is the nearest
+			while (!Stack.IsEmpty())
+			{
+				const FEntry Entry = Stack.Pop(EAllowShrinking::No);
+
+				if (Entry.Level == FNodeLink::LeafLevel)
+				{
+					if (RaycastLeaf(Ray, Entry.Index, Entry.VoxelMin, Entry.Time, OutTime))
+					{
+						return true;
+					}
+					
+					continue;
+				}
+
+				const FNode Node = GetNode(Entry.Level, Entry.Index);
+
+				if (Node.IsSolid())
+				{
+					OutTime = Entry.Time;
+					return true;
+				}
+
+				const int32 ChildLog2Size = GetLevelShift(Entry.Level) / 3 - 1;
+
+				for (int32 Order = 7; Order >= 0; --Order)
+				{
+					const int32 Octant = Order ^ Ray.OctantMask;
+					const FIntVector ChildMin = Entry.VoxelMin + FVoxelRay::GetOctantOffset(Octant, ChildLog2Size);
+					double Time;
+
+					if (HasChild(Node, Octant) && Ray.Intersects(ChildMin, ChildLog2Size, Time))
+					{
+						Stack.Add(FEntry { Entry.Level - 1, ChildIndex(Node, Octant), ChildMin, Time });
+					}
+				}
+			}
+
+			return false;
+		}
+
+		/** Draws every node of a level - as persistent lines if LifeTime is negative, otherwise lines that expire after LifeTime seconds. */
+		void DebugDrawLevel(const UWorld* World, const int32 Level, const FColor Color, const float LifeTime = -1.f) const
+		{
+#if WITH_EDITOR
+			for (int32 NodeIndex = 0; NodeIndex < NumNodes(Level); ++NodeIndex)
+			{
+				const FVector Center = FVector(GetPosition(FNodeLocation { Level, NodeIndex }));
+				const FVector Extent = FVector(GetHalfSize(Level)); 
+				DrawDebugBox(World, Center, Extent, FQuat::Identity, Color, LifeTime < 0.f, LifeTime);
+			}
+#endif // WITH_EDITOR
+		}
+
+		void DebugDraw(const UWorld* World, const FColor Color1 = FColor::Red, const FColor Color2 = FColor::Green, const float LifeTime = -1.f) const
+		{
+#if WITH_EDITOR
+			TArray<FMortonCode> LeafCodes;
+
+			if constexpr (bBrickLeaves)
+			{
+				// Every occupied voxel of a brick is its own leaf code
+				for (int32 LeafIndex = 0; LeafIndex < Leaves.Num(); ++LeafIndex)
+				{
+					for (uint64 Mask = Bricks[LeafIndex]; Mask != 0; Mask &= Mask - 1)
+					{
+						LeafCodes.Add(GetLeafCode(LeafIndex) | FMath::CountTrailingZeros64(Mask));
+					}
+				}
+			}
+			else
+			{
+				LeafCodes = Leaves;
+			}
+			
+			TArray<FIntVector> LeafPositions;
+			LeafPositions.SetNumUninitialized(LeafCodes.Num());
+			DecodeMortonBatch(LeafCodes, LeafPositions);
+			
+			for (const FIntVector& LeafPosition : LeafPositions)
+			{
+				const FVector Center = FVector(DequantizeVoxel<VoxelSize>(LeafPosition));
+				const FVector Extent = FVector(TVoxelTraits<VoxelSize>::HalfVoxelSize);
+				DrawDebugBox(World, Center, Extent, FQuat::Identity, Color1, LifeTime < 0.f, LifeTime);
+			}
+
+			for (int32 Level = 0; Level < NumLevels(); ++Level)
+			{
+				DebugDrawLevel(World, Level, Level % 2 == 0 ? Color2 : Color1, LifeTime);
+			}
+#endif // WITH_EDITOR
+		}
+		
+		/** Leaf codes and solid blocks with the occupancy of the octree, as the input of a build - bricks are expanded to their voxels.
+		 *	Made on demand (e.g. to splice a dirty region into) rather than kept next to the octree, which would hold every leaf twice.
+		 */
+		FOctreeCodes GetCodes() const
+		{
+			FOctreeCodes Codes;
+
+			if constexpr (bBrickLeaves)
+			{
+				int32 NumVoxels = 0;
+				for (const uint64 Brick : Bricks) NumVoxels += FMath::CountBits(Brick);
+				Codes.Leaves.Reserve(NumVoxels);
+
+				for (int32 LeafIndex = 0; LeafIndex < Leaves.Num(); ++LeafIndex)
+				{
+					// Bit N is the voxel with local morton index N, so the voxels come out sorted
+					for (uint64 Brick = Bricks[LeafIndex]; Brick != 0; Brick &= Brick - 1)
+					{
+						Codes.Leaves.Add(Leaves[LeafIndex] << 6 | FMath::CountTrailingZeros64(Brick));
+					}
+				}
+			}
+			else
+			{
+				Codes.Leaves = Leaves;
+			}
+
+			// A node of level N is a block of 2^(N + 1 + LeafLog2Size) voxels per axis
+			for (int32 Level = 0; Level < NumLevels(); ++Level)
+			{
+				if (NumSolids(Level) > 0)
+				{
+					Codes.Solids.SetNum(Level + LeafLog2Size + 1);
+					Codes.Solids[Level + LeafLog2Size].Append(Solids.GetData() + SolidOffsets[Level], NumSolids(Level));
+				}
+			}
+
+			return Codes;
+		}
+		
+		/** Bytes used by the leaves (codes and bricks). */
+		SIZE_T GetLeafAllocatedSize() const
+		{
+			return Leaves.GetAllocatedSize() + Bricks.GetAllocatedSize() + LeafLinks.GetAllocatedSize();
+		}
+
+		/** Bytes used by a level - its share of the flat node, solid code, level code and link arrays. */
+		SIZE_T GetLevelAllocatedSize(const int32 Level) const
+		{
+			const SIZE_T NumLevelNodes = NumNodes(Level);
+			SIZE_T AllocatedSize = NumLevelNodes * (sizeof(int32) + sizeof(uint8)) + NumSolids(Level) * sizeof(FMortonCode);
+			if constexpr (bLevelCodes) AllocatedSize += NumLevelNodes * sizeof(FMortonCode);
+			if constexpr (bNeighbourLinks) AllocatedSize += NumLevelNodes * sizeof(FNodeLinks);
+			return AllocatedSize;
+		}
+
+		/** Logs the memory of the leaves and every level - used to compare layouts on the same scene. */
+		void LogMemoryUsage() const
+		{
+			UE_LOG(LogTemp, Log, TEXT("Octree (%s leaves): %d leaves, %llu bytes"),
+				bBrickLeaves ? TEXT("brick") : TEXT("voxel"), Leaves.Num(), static_cast<uint64>(GetLeafAllocatedSize()));
+
+			for (int32 Level = 0; Level < NumLevels(); ++Level)
+			{
+				UE_LOG(LogTemp, Log, TEXT("Octree level %d: %d nodes, %d solid, %llu bytes"),
+					Level, NumNodes(Level), NumSolids(Level), static_cast<uint64>(GetLevelAllocatedSize(Level)));
+			}
+		}
+		
+		/** Saves or loads every array of the octree. The arrays are pointer free and flat across the levels, so the octree is a fixed
+		 *	number of bulk copies whatever its depth. The layout isn't stored, whoever owns the archive has to check it matches.
+		 *	Loading reads each array into an allocation of its own rather than viewing a mapped file - cooked files can sit compressed in a
+		 *	pak where no mapping exists, and tiles are shared into later updates so a view would have to keep the whole file alive.
+		 */
+		void Serialize(FArchive& Ar)
+		{
+			LevelOffsets.BulkSerialize(Ar);
+			FirstChildIndices.BulkSerialize(Ar);
+			ChildBitMasks.BulkSerialize(Ar);
+			SolidOffsets.BulkSerialize(Ar);
+			Solids.BulkSerialize(Ar);
+			if constexpr (bLevelCodes) LevelCodes.BulkSerialize(Ar);
+			if constexpr (bNeighbourLinks) Links.BulkSerialize(Ar);
+
+			Leaves.BulkSerialize(Ar);
+			if constexpr (bBrickLeaves) Bricks.BulkSerialize(Ar);
+			if constexpr (bNeighbourLinks && bBrickLeaves) LeafLinks.BulkSerialize(Ar);
+		}
+		
+		// Nodes of every level in one breadth-first allocation per field, level 0 first - node N of a level is at GetNodeOffset(Level) + N.
+		// Split by field so a descent that only tests child masks streams a byte per node, and no padding is stored.
+		TArray<int32> LevelOffsets; // First node of each level, plus the total node count
+		TArray<int32> FirstChildIndices; // Index of the first child in the level below, or of the node's code in Solids if solid
+		TArray<uint8> ChildBitMasks; // Octants with a child, 0 for a solid node
+		
+		FLeaves Leaves; // Morton codes of the leaves - voxel codes, or brick codes (voxel code >> 6) with BrickLeaves
+		FBricks Bricks; // Occupancy of each brick with BrickLeaves, bit N is the voxel with local morton index N
+		TArray<int32> SolidOffsets; // First solid of each level in Solids, plus the total solid count
+		FLeaves Solids; // Node codes of the solid nodes, level by level
+		FLeaves LevelCodes; // Node codes of every node with LevelCodes, aligned with the flat node arrays
+		TArray<FNodeLinks> Links; // Face neighbours of every node with NeighbourLinks, aligned with the flat node arrays
+		TArray<FNodeLinks> LeafLinks; // Face neighbours of every brick with NeighbourLinks and BrickLeaves, aligned with Leaves
+
+		/** Below this many codes a level isn't worth splitting across workers. */
+		static constexpr int32 MinParallelLevelNum = 1 << 16;
+		
+	private:
+		/** Raycast within a leaf - a voxel leaf is hit where the segment enters it, a brick is walked as two more levels of its mask. */
+		FORCEINLINE bool RaycastLeaf(const FVoxelRay& Ray, const int32 LeafIndex, const FIntVector& VoxelMin, const double Time, double& OutTime) const
+		{
+			if (IsLeafSolid(LeafIndex))
+			{
+				OutTime = Time;
+				return true;
+			}
+
+			if constexpr (bBrickLeaves)
+			{
+				const uint64 Brick = Bricks[LeafIndex];
+
+				for (int32 Order = 0; Order < 8; ++Order)
+				{
+					// Each 2x2x2 octant of a brick is 8 consecutive bits
+					const int32 Octant = Order ^ Ray.OctantMask;
+					const uint8 OctantBits = static_cast<uint8>(Brick >> (8 * Octant));
+					const FIntVector OctantMin = VoxelMin + FVoxelRay::GetOctantOffset(Octant, 1);
+					double OctantTime;
+
+					if (OctantBits == 0 || !Ray.Intersects(OctantMin, 1, OctantTime))
+					{
+						continue;
+					}
+
+					for (int32 VoxelOrder = 0; VoxelOrder < 8; ++VoxelOrder)
+					{
+						const int32 Voxel = VoxelOrder ^ Ray.OctantMask;
+
+						if ((OctantBits & 1 << Voxel) != 0 && Ray.Intersects(OctantMin + FVoxelRay::GetOctantOffset(Voxel, 0), 0, OutTime))
+						{
+							return true;
+						}
+					}
+				}
+			}
+
+			return false;
+		}
+		
+		/** Builds the level above a layer of sorted codes - one node per unique parent code, with the octants present as its child mask.
+		 *	With bCollapseSolids a parent of 8 solid children becomes a solid node and the children are dropped from the layer below.
+		 *	Large layers are cut into chunks that start on a parent boundary. Parents and kept children are counted per chunk, prefix summed
+		 *	into output offsets and every chunk is then filled in parallel, so the result is identical to a single serial scan.
+		 */
+		void BuildLevel(TArray<FMortonCode>& InOutItrCodes, FLevel& InOutItrLevel, const bool bAboveLeaves, const bool bCollapseSolids, const bool bParallel,
+			TArray<FMortonCode>& OutCodes, FLevel& OutLevel)
+		{
+			const int32 Num = InOutItrCodes.Num();
+			const FMortonCode* ItrCodes = InOutItrCodes.GetData();
+			const FNode* ItrNodes = InOutItrLevel.GetData();
+
+			// Visits every run of codes with the same parent in [ChunkBegin, ChunkEnd) - chunks never split a run
+			const auto ForEachParent = [&](const int32 ChunkBegin, const int32 ChunkEnd, auto&& Visit)
+			{
+				for (int32 Begin = ChunkBegin, End = ChunkBegin; Begin < ChunkEnd; Begin = End)
+				{
+					// Shifting 3-bits of a code can produce up to 8 of the same code (e.g. 1 node with 1-8 octants)
+					const FMortonCode ParentCode = ItrCodes[Begin] >> 3;
+					bool bAllSolid = bCollapseSolids;
+
+					for (End = Begin; End < ChunkEnd && ItrCodes[End] >> 3 == ParentCode; ++End)
+					{
+						bAllSolid &= bAboveLeaves ? IsLeafSolid(End) : ItrNodes[End].IsSolid();
+					}
+
+					// Every octant is solid - the node stands in for its children which are dropped from the layer below
+					Visit(Begin, End, ParentCode, bAllSolid && End - Begin == 8);
+				}
+			};
+
+			const int32 NumWorkers = FMath::Max(1, FTaskGraphInterface::Get().GetNumWorkerThreads());
+			const int32 NumChunks = bParallel ? FMath::Clamp(Num / MinParallelLevelNum, 1, NumWorkers * 2) : 1;
+			const int32 ChunkSize = FMath::DivideAndRoundUp(FMath::Max(Num, 1), NumChunks);
+			
+			TArray<int32, TInlineAllocator<65>> ChunkBegins;
+			TArray<int32, TInlineAllocator<65>> ParentOffsets;
+			TArray<int32, TInlineAllocator<65>> KeptOffsets;
+			ChunkBegins.SetNumUninitialized(NumChunks + 1);
+			ParentOffsets.SetNumZeroed(NumChunks + 1);
+			KeptOffsets.SetNumZeroed(NumChunks + 1);
+
+			// Moved forward to the start of the next run - a run is at most 8 codes so the chunks stay in order
+			for (int32 Chunk = 0; Chunk <= NumChunks; ++Chunk)
+			{
+				int32 Begin = FMath::Min(Chunk * ChunkSize, Num);
+				while (Begin > 0 && Begin < Num && ItrCodes[Begin] >> 3 == ItrCodes[Begin - 1] >> 3) ++Begin;
+				ChunkBegins[Chunk] = Begin;
+			}
+
+			// A single chunk compacts the layer below in place as the serial scan always did - sized for the worst case and trimmed after
+			const bool bInPlace = NumChunks == 1;
+
+			if (!bInPlace)
+			{
+				ParallelFor(TEXT("NavVolume.CountOctreeLevel"), NumChunks, 1, [&](const int32 Chunk)
+				{
+					int32 NumParents = 0;
+					int32 NumKept = 0;
+					
+					ForEachParent(ChunkBegins[Chunk], ChunkBegins[Chunk + 1], [&](const int32 Begin, const int32 End, FMortonCode, const bool bCollapsed)
+					{
+						++NumParents;
+						if (!bCollapsed) NumKept += End - Begin;
+					});
+
+					ParentOffsets[Chunk + 1] = NumParents;
+					KeptOffsets[Chunk + 1] = NumKept;
+				});
+
+				for (int32 Chunk = 0; Chunk < NumChunks; ++Chunk)
+				{
+					ParentOffsets[Chunk + 1] += ParentOffsets[Chunk];
+					KeptOffsets[Chunk + 1] += KeptOffsets[Chunk];
+				}
+			}
+
+			const int32 MaxNumParents = bInPlace ? Num : ParentOffsets[NumChunks];
+			OutCodes.SetNumUninitialized(MaxNumParents);
+			OutLevel.SetNumUninitialized(MaxNumParents);
+
+			// In parallel a chunk could overwrite codes the chunk before it still reads, so kept children go to new arrays - unless none were dropped
+			const bool bCompact = bInPlace || KeptOffsets[NumChunks] != Num;
+			TArray<FMortonCode> KeptCodes;
+			FLevel KeptLevel;
+			FBricks KeptBricks;
+
+			if (bCompact && !bInPlace)
+			{
+				KeptCodes.SetNumUninitialized(KeptOffsets[NumChunks]);
+				if (!bAboveLeaves) KeptLevel.SetNumUninitialized(KeptOffsets[NumChunks]);
+				else if constexpr (bBrickLeaves) KeptBricks.SetNumUninitialized(KeptOffsets[NumChunks]);
+			}
+
+			FMortonCode* DstCodes = bInPlace ? InOutItrCodes.GetData() : KeptCodes.GetData();
+			FNode* DstNodes = bInPlace ? InOutItrLevel.GetData() : KeptLevel.GetData();
+			uint64* DstBricks = bInPlace ? Bricks.GetData() : KeptBricks.GetData();
+
+			const auto FillChunk = [&](const int32 Chunk)
+			{
+				int32 ParentIndex = ParentOffsets[Chunk];
+				int32 KeptIndex = KeptOffsets[Chunk];
+				
+				ForEachParent(ChunkBegins[Chunk], ChunkBegins[Chunk + 1], [&](const int32 Begin, const int32 End, const FMortonCode ParentCode, const bool bCollapsed)
+				{
+					OutCodes[ParentIndex] = ParentCode;
+					FNode& Node = OutLevel[ParentIndex++];
+					Node = FNode();
+
+					if (bCollapsed)
+					{
+						return;
+					}
+
+					Node.FirstChildIndex = KeptIndex;
+
+					for (int32 ItrIndex = Begin; ItrIndex < End; ++ItrIndex, ++KeptIndex)
+					{
+						// The last 3-bits of a code represent the relative octant
+						Node.ChildBitMask |= 1 << (ItrCodes[ItrIndex] & 7);
+
+						if (bCompact)
+						{
+							DstCodes[KeptIndex] = ItrCodes[ItrIndex];
+							if (!bAboveLeaves) DstNodes[KeptIndex] = ItrNodes[ItrIndex];
+							else if constexpr (bBrickLeaves) DstBricks[KeptIndex] = Bricks[ItrIndex];
+						}
+					}
+				});
+
+				if (bInPlace)
+				{
+					ParentOffsets[1] = ParentIndex;
+					KeptOffsets[1] = KeptIndex;
+				}
+			};
+
+			if (bInPlace)
+			{
+				FillChunk(0);
+				OutCodes.SetNum(ParentOffsets[1]);
+				OutLevel.SetNum(ParentOffsets[1]);
+				InOutItrCodes.SetNum(KeptOffsets[1]);
+				if (!bAboveLeaves) InOutItrLevel.SetNum(KeptOffsets[1]);
+				else if constexpr (bBrickLeaves) Bricks.SetNum(KeptOffsets[1]);
+			}
+			else
+			{
+				ParallelFor(TEXT("NavVolume.BuildOctreeLevel"), NumChunks, 1, FillChunk);
+
+				if (bCompact)
+				{
+					InOutItrCodes = MoveTemp(KeptCodes);
+					if (!bAboveLeaves) InOutItrLevel = MoveTemp(KeptLevel);
+					else if constexpr (bBrickLeaves) Bricks = MoveTemp(KeptBricks);
+				}
+			}
+		}
+
+		/** True if a leaf is completely occupied - a voxel always is, a brick only when full. */
+		FORCEINLINE bool IsLeafSolid(const int32 LeafIndex) const
+		{
+			if constexpr (bBrickLeaves)
+			{
+				return Bricks[LeafIndex] == SolidBrick;
+			}
+			
+			return true;
+		}
+
+		/** Packs sorted leaf voxel codes into 4x4x4 bricks - the low 6 bits of a code are the voxel's index within its brick.
+		 *	Solid blocks smaller than a level 0 node (2x2x2 and 4x4x4) are folded into the brick masks. InOutCodes become the brick codes.
+		 */
+		void BuildBricks(TArray<FMortonCode>& InOutCodes, FOctreeCodes& Codes)
+		{
+			// Merges two sorted brick sets, masks of the same brick are combined
+			const auto MergeBricks = [](const FLeaves& CodesA, const FBricks& MasksA, const FLeaves& CodesB, const FBricks& MasksB, FLeaves& OutCodes, FBricks& OutMasks)
+			{
+				OutCodes.Reset(CodesA.Num() + CodesB.Num());
+				OutMasks.Reset(CodesA.Num() + CodesB.Num());
+				
+				int32 IndexA = 0;
+				int32 IndexB = 0;
+				
+				while (IndexA < CodesA.Num() || IndexB < CodesB.Num())
+				{
+					const bool bTakeA = IndexB == CodesB.Num() || (IndexA < CodesA.Num() && CodesA[IndexA] <= CodesB[IndexB]);
+					const FMortonCode Code = bTakeA ? CodesA[IndexA] : CodesB[IndexB];
+					const uint64 Mask = bTakeA ? MasksA[IndexA++] : MasksB[IndexB++];
+
+					if (!OutCodes.IsEmpty() && OutCodes.Last() == Code)
+					{
+						OutMasks.Last() |= Mask;
+					}
+					else
+					{
+						OutCodes.Add(Code);
+						OutMasks.Add(Mask);
+					}
+				}
+			};
+
+			// Appends to a sorted brick set, combining with the last brick if it is the same one
+			const auto AddToBrick = [](FLeaves& OutCodes, FBricks& OutMasks, const FMortonCode Code, const uint64 Mask)
+			{
+				if (!OutCodes.IsEmpty() && OutCodes.Last() == Code)
+				{
+					OutMasks.Last() |= Mask;
+				}
+				else
+				{
+					OutCodes.Add(Code);
+					OutMasks.Add(Mask);
+				}
+			};
+			
+			FLeaves LeafCodes;
+			FBricks LeafMasks;
+			
+			for (const FMortonCode Code : InOutCodes)
+			{
+				AddToBrick(LeafCodes, LeafMasks, Code >> 6, uint64(1) << (Code & 63));
+			}
+
+			// A 2x2x2 block is one octant (8 consecutive bits) of a brick and a 4x4x4 block is the whole brick
+			FLeaves SolidCodes[2];
+			FBricks SolidMasks[2];
+
+			if (Codes.Solids.IsValidIndex(0))
+			{
+				for (const FMortonCode Code : Codes.Solids[0])
+				{
+					AddToBrick(SolidCodes[0], SolidMasks[0], Code >> 3, uint64(0xFF) << (8 * (Code & 7)));
+				}
+
+				Codes.Solids[0].Empty();
+			}
+
+			if (Codes.Solids.IsValidIndex(1))
+			{
+				for (const FMortonCode Code : Codes.Solids[1])
+				{
+					AddToBrick(SolidCodes[1], SolidMasks[1], Code, SolidBrick);
+				}
+
+				Codes.Solids[1].Empty();
+			}
+
+			FLeaves MergedCodes;
+			FBricks MergedMasks;
+			MergeBricks(SolidCodes[0], SolidMasks[0], SolidCodes[1], SolidMasks[1], MergedCodes, MergedMasks);
+			MergeBricks(LeafCodes, LeafMasks, MergedCodes, MergedMasks, InOutCodes, Bricks);
+		}
+
+		/** Drops leaves and solid blocks that lie inside a larger solid block (e.g. where shapes overlap). */
+		static void RemoveCoveredCodes(FOctreeCodes& Codes)
+		{
+			// Each solid block covers the leaf codes [Begin, End)
+			struct FRange
+			{
+				FMortonCode Begin;
+				FMortonCode End;
+				int32 Level;
+			};
+
+			TArray<FRange> Ranges;
+			
+			for (int32 Level = 0; Level < Codes.Solids.Num(); ++Level)
+			{
+				const int32 Shift = 3 * (Level + 1);
+				
+				for (const FMortonCode Code : Codes.Solids[Level])
+				{
+					Ranges.Add({ Code << Shift, (Code + 1) << Shift, Level });
+				}
+
+				Codes.Solids[Level].Reset();
+			}
+
+			if (Ranges.IsEmpty())
+			{
+				return;
+			}
+
+			// Aligned blocks are either nested or disjoint - sorting larger blocks first means any nested block directly follows its container
+			Ranges.Sort([](const FRange& A, const FRange& B) { return A.Begin != B.Begin ? A.Begin < B.Begin : A.End > B.End; });
+
+			TArray<FRange> Kept;
+			
+			for (const FRange& Range : Ranges)
+			{
+				if (Kept.IsEmpty() || Range.Begin >= Kept.Last().End)
+				{
+					Kept.Add(Range);
+					Codes.Solids[Range.Level].Add(Range.Begin >> (3 * (Range.Level + 1)));
+				}
+			}
+
+			// Leaves and kept ranges are both sorted so a single sweep finds every covered leaf
+			int32 RangeIndex = 0;
+			int32 NumLeaves = 0;
+			
+			for (const FMortonCode Leaf : Codes.Leaves)
+			{
+				while (RangeIndex < Kept.Num() && Kept[RangeIndex].End <= Leaf)
+				{
+					++RangeIndex;
+				}
+
+				if (RangeIndex == Kept.Num() || Leaf < Kept[RangeIndex].Begin)
+				{
+					Codes.Leaves[NumLeaves++] = Leaf;
+				}
+			}
+
+			Codes.Leaves.SetNum(NumLeaves);
+		}
+
+		static bool HasSolidsAbove(const FOctreeCodes& Codes, const int32 Level)
+		{
+			for (int32 ItrLevel = Level + 1; ItrLevel < Codes.Solids.Num(); ++ItrLevel)
+			{
+				if (!Codes.Solids[ItrLevel].IsEmpty())
+				{
+					return true;
+				}
+			}
+			
+			return false;
+		}
+
+		/** Merges solid blocks into a level under construction - both are sorted and disjoint. */
+		static void MergeSolids(TArray<FMortonCode>& LevelCodes, FLevel& Level, const TArray<FMortonCode>& SolidCodes)
+		{
+			TArray<FMortonCode> MergedCodes;
+			FLevel MergedLevel;
+			MergedCodes.Reserve(LevelCodes.Num() + SolidCodes.Num());
+			MergedLevel.Reserve(LevelCodes.Num() + SolidCodes.Num());
+
+			int32 LevelIndex = 0;
+			int32 SolidIndex = 0;
+			
+			while (LevelIndex < LevelCodes.Num() || SolidIndex < SolidCodes.Num())
+			{
+				if (SolidIndex == SolidCodes.Num() || (LevelIndex < LevelCodes.Num() && LevelCodes[LevelIndex] <= SolidCodes[SolidIndex]))
+				{
+					// A node that already exists takes priority over a solid block with the same code
+					if (SolidIndex < SolidCodes.Num() && LevelCodes[LevelIndex] == SolidCodes[SolidIndex])
+					{
+						++SolidIndex;
+					}
+					
+					MergedCodes.Add(LevelCodes[LevelIndex]);
+					MergedLevel.Add(Level[LevelIndex++]);
+				}
+				else
+				{
+					MergedCodes.Add(SolidCodes[SolidIndex++]);
+					MergedLevel.AddDefaulted();
+				}
+			}
+
+			LevelCodes = MoveTemp(MergedCodes);
+			Level = MoveTemp(MergedLevel);
+		}
+
+		/** Appends a finished level to the flat arrays - levels are finished bottom up so they land in level order.
+		 *	Solid nodes always keep their code as they have no children to find it through, with LevelCodes every code is kept.
+		 */
+		void FinalizeLevel(const FLevel& Level, const TArray<FMortonCode>& Codes)
+		{
+			if (LevelOffsets.IsEmpty())
+			{
+				LevelOffsets.Add(0);
+				SolidOffsets.Add(0);
+			}
+
+			FirstChildIndices.Reserve(FirstChildIndices.Num() + Level.Num());
+			ChildBitMasks.Reserve(ChildBitMasks.Num() + Level.Num());
+			
+			for (int32 NodeIndex = 0; NodeIndex < Level.Num(); ++NodeIndex)
+			{
+				const FNode Node = Level[NodeIndex];
+				FirstChildIndices.Add(Node.IsSolid() ? Solids.Add(Codes[NodeIndex]) : Node.FirstChildIndex);
+				ChildBitMasks.Add(Node.ChildBitMask);
+			}
+
+			LevelOffsets.Add(FirstChildIndices.Num());
+			SolidOffsets.Add(Solids.Num());
+
+			if constexpr (bLevelCodes)
+			{
+				LevelCodes.Append(Codes);
+			}
+		}
+
+		/** Drops the slack the flat arrays grew while levels were appended - a built octree never grows. */
+		void ShrinkLevels()
+		{
+			FirstChildIndices.Shrink();
+			ChildBitMasks.Shrink();
+			Solids.Shrink();
+			if constexpr (bLevelCodes) LevelCodes.Shrink();
+		}
+
+		/** Links every node (and brick) to its face neighbours. Each level is independent so the nodes of a level are linked in parallel.
+		 *	A missing neighbour is inside an empty octant of the first ancestor level that has a node there, or a solid node that covers it.
+		 */
+		void BuildNeighbourLinks()
+		{
+			// Levels only keep their codes with LevelCodes - otherwise find them once up front rather than per lookup
+			FLeaves TempCodes;
+
+			if constexpr (!bLevelCodes)
+			{
+				TempCodes.SetNumUninitialized(FirstChildIndices.Num());
+				
+				ParallelFor(NumLevels(), [this, &TempCodes](const int32 Level)
+				{
+					for (int32 NodeIndex = 0; NodeIndex < NumNodes(Level); ++NodeIndex)
+					{
+						TempCodes[GetNodeOffset(Level) + NodeIndex] = GetMortonCode(GetNode(Level, NodeIndex), Level) >> GetLevelShift(Level);
+					}
+				});
+			}
+
+			const FLeaves& NodeCodes = bLevelCodes ? LevelCodes : TempCodes;
+			
+			const auto GetCodes = [this, &NodeCodes](const int32 Level) -> TConstArrayView<FMortonCode>
+			{
+				return Level == FNodeLink::LeafLevel ? MakeArrayView(Leaves) : MakeArrayView(NodeCodes).Slice(GetNodeOffset(Level), NumNodes(Level));
+			};
+
+			// Finds the element that covers a node code at a level, going up a level each time nothing is there
+			const auto FindLink = [this, &GetCodes](int32 Level, FMortonCode Code) -> FNodeLink
+			{
+				const int32 Index = Algo::BinarySearch(GetCodes(Level), Code);
+
+				if (Index != INDEX_NONE)
+				{
+					return FNodeLink::Make(FNodeLink::EType::Node, Level, Index);
+				}
+
+				for (++Level; Level < NumLevels(); ++Level)
+				{
+					const int32 Octant = Code & 7;
+					Code >>= 3;
+					
+					const int32 ParentIndex = Algo::BinarySearch(GetCodes(Level), Code);
+					
+					if (ParentIndex != INDEX_NONE)
+					{
+						return GetNode(Level, ParentIndex).IsSolid()
+							? FNodeLink::Make(FNodeLink::EType::Node, Level, ParentIndex)
+							: FNodeLink::Make(FNodeLink::EType::Octant, Level, ParentIndex, Octant);
+					}
+				}
+
+				return FNodeLink(); // Outside the root
+			};
+
+			const auto LinkLevel = [&FindLink](const int32 Level, const TConstArrayView<FMortonCode> Codes, const TArrayView<FNodeLinks> OutLinks)
+			{
+				const int32 NumBits = 21 - GetLevelShift(Level) / 3;
+
+				ParallelFor(Codes.Num(), [&](const int32 NodeIndex)
+				{
+					for (int32 Direction = 0; Direction < NumDirections; ++Direction)
+					{
+						FMortonCode NeighbourCode;
+						const bool bInside = StepMorton(Codes[NodeIndex], Direction / 2, Direction & 1, NeighbourCode, NumBits);
+						OutLinks[NodeIndex][Direction] = bInside ? FindLink(Level, NeighbourCode) : FNodeLink();
+					}
+				});
+			};
+
+			Links.SetNum(FirstChildIndices.Num());
+
+			for (int32 Level = 0; Level < NumLevels(); ++Level)
+			{
+				LinkLevel(Level, GetCodes(Level), MakeArrayView(Links).Slice(GetNodeOffset(Level), NumNodes(Level)));
+			}
+
+			if constexpr (bBrickLeaves)
+			{
+				LeafLinks.SetNum(Leaves.Num());
+				LinkLevel(FNodeLink::LeafLevel, GetCodes(FNodeLink::LeafLevel), MakeArrayView(LeafLinks));
 			}
-#endif // WITH_EDITOR
 		}
-		
-		FLevels Levels;
-		FLeaves Leaves;
 	};
 } // namespace NavVolume::Octree
@@ -0,0 +1,170 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Algo/Reverse.h"
+#include "NavVolumeOctree.h"
+
+namespace NavVolume::Path
+{
+	using namespace NavVolume::Octree;
+
+	struct FPathSettings
+	{
+		/** A search gives up after expanding this many elements. */
+		int32 MaxIterations = 65536;
+
+		/** Radius of the agent in world units - searched on the smallest agent profile of the volume that fits it (see FVoxelizerSettings). */
+		float AgentRadius = 0.f;
+	};
+
+	struct FPathRequest
+	{
+		FVector Start;
+		FVector End;
+	};
+
+	struct FPathResult
+	{
+		bool bSuccess = false;
+
+		/** Start, the centers of every element passed through, then End. */
+		TArray<FVector> Points;
+	};
+
+	/** Open and closed sets of a search - kept per thread and only reset between searches so queries stop allocating once warm. */
+	struct FSearchScratch
+	{
+		struct FRecord
+		{
+			FNodeLink Parent;
+			double Cost = 0.0;
+			bool bClosed = false;
+		};
+
+		struct FOpenEntry
+		{
+			double Priority;
+			FNodeLink Link;
+
+			FORCEINLINE bool operator<(const FOpenEntry& Other) const
+			{
+				return Priority < Other.Priority;
+			}
+		};
+
+		TMap<FNodeLink, FRecord> Records;
+		TArray<FOpenEntry> Open;
+		TArray<FNodeLink> Neighbours;
+
+		void Reset()
+		{
+			Records.Reset();
+			Open.Reset();
+			Neighbours.Reset();
+		}
+
+		static FSearchScratch& Get()
+		{
+			static thread_local FSearchScratch Scratch;
+			return Scratch;
+		}
+	};
+
+	/** Hierarchical A* over the free space of an octree built with EOctreeLayout::NeighbourLinks, or a tiled octree of them.
+	 *	Empty octants are searched at their own size, so open space costs one step per large node and the search only refines
+	 *	down to bricks near geometry.
+	 */
+	template<typename OctreeType>
+	struct TPathfinder
+	{
+		static_assert(OctreeType::bNeighbourLinks, "Pathfinding requires EOctreeLayout::NeighbourLinks");
+
+		static FPathResult FindPath(const OctreeType& Octree, const FVector& Start, const FVector& End, const FPathSettings& Settings = {})
+		{
+			FPathResult Result;
+
+			const FNodeLink StartLink = Octree.FindLink(Start);
+			const FNodeLink EndLink = Octree.FindLink(End);
+
+			if (!Octree.IsLinkFree(StartLink) || !Octree.IsLinkFree(EndLink))
+			{
+				return Result;
+			}
+
+			// Both ends in one free element - it's convex, so the straight line between them is the path
+			if (StartLink == EndLink)
+			{
+				Result.Points = { Start, End };
+				Result.bSuccess = true;
+				return Result;
+			}
+
+			// The end points stand in for the centers of their own elements
+			const auto GetPosition = [&](const FNodeLink Link)
+			{
+				return Link == StartLink ? Start : Link == EndLink ? End : Octree.GetLinkBounds(Link).GetCenter();
+			};
+
+			FSearchScratch& Scratch = FSearchScratch::Get();
+			Scratch.Reset();
+
+			Scratch.Records.Add(StartLink, FSearchScratch::FRecord { FNodeLink(), 0.0, false });
+			Scratch.Open.HeapPush(FSearchScratch::FOpenEntry { FVector::Dist(Start, End), StartLink });
+
+			for (int32 Iteration = 0; Iteration < Settings.MaxIterations && !Scratch.Open.IsEmpty(); ++Iteration)
+			{
+				FSearchScratch::FOpenEntry Entry;
+				Scratch.Open.HeapPop(Entry, EAllowShrinking::No);
+
+				FSearchScratch::FRecord& Record = Scratch.Records.FindChecked(Entry.Link);
+
+				// A stale entry - the element was reached more cheaply since it was pushed
+				if (Record.bClosed)
+				{
+					continue;
+				}
+
+				if (Entry.Link == EndLink)
+				{
+					for (FNodeLink Link = EndLink; Link.IsValid(); Link = Scratch.Records.FindChecked(Link).Parent)
+					{
+						Result.Points.Add(GetPosition(Link));
+					}
+
+					Algo::Reverse(Result.Points);
+					Result.bSuccess = true;
+					return Result;
+				}
+
+				Record.bClosed = true;
+
+				const double Cost = Record.Cost;
+				const FVector Position = GetPosition(Entry.Link);
+
+				Scratch.Neighbours.Reset();
+
+				for (int32 Direction = 0; Direction < OctreeType::NumDirections; ++Direction)
+				{
+					Octree.CollectFreeNeighbours(Entry.Link, Direction, Scratch.Neighbours);
+				}
+
+				for (const FNodeLink Neighbour : Scratch.Neighbours)
+				{
+					const FVector NeighbourPosition = GetPosition(Neighbour);
+					const double NeighbourCost = Cost + FVector::Dist(Position, NeighbourPosition);
+					const FSearchScratch::FRecord* NeighbourRecord = Scratch.Records.Find(Neighbour);
+
+					if (NeighbourRecord != nullptr && (NeighbourRecord->bClosed || NeighbourRecord->Cost <= NeighbourCost))
+					{
+						continue;
+					}
+
+					Scratch.Records.Add(Neighbour, FSearchScratch::FRecord { Entry.Link, NeighbourCost, false });
+					Scratch.Open.HeapPush(FSearchScratch::FOpenEntry { NeighbourCost + FVector::Dist(NeighbourPosition, End), Neighbour });
+				}
+			}
+
+			return Result;
+		}
+	};
+} // namespace NavVolume::Path
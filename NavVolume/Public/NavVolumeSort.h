@@ -0,0 +1,33 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "NavVolumeMorton.h"
+
+/** Sorting and merging of morton code arrays.
+ *	Voxelizers each produce a sorted, unique run of codes - combining them is a merge rather than another global sort.
+ */
+namespace NavVolume::Sort
+{
+	using namespace NavVolume::Morton;
+
+	/** Sorts the codes in ascending order and removes any duplicates. */
+	NAVVOLUME_API void SortUnique(TArray<FMortonCode>& Codes);
+
+	/** Multi-threaded LSD radix sort (8-bit digits) that removes duplicates while copying out of the final pass.
+	 *	Digits that are identical in every key are skipped - a small area only varies in its low bits so most passes disappear.
+	 *	Small arrays fall back to a comparison sort.
+	 */
+	NAVVOLUME_API void RadixSortUnique(TArray<FMortonCode>& Codes);
+
+	/** Merges two sorted runs into Out, duplicates (across or within runs) are only written once.
+	 *	Large inputs are split into independent chunks and merged in parallel - never between equal codes, so no duplicate straddles a seam.
+	 */
+	NAVVOLUME_API void MergeUnique(TConstArrayView<FMortonCode> A, TConstArrayView<FMortonCode> B, TArray<FMortonCode>& Out);
+	
+	/** Merges any number of sorted, unique runs into a single sorted, unique array - a run with duplicates of its own keeps them
+	 *	if it is concatenated rather than merged.
+	 *	Runs are merged pairwise as a tree - every pair in a round is merged in parallel and the inputs are released as soon as they are consumed.
+	 *	Runs that already follow each other without overlapping are just concatenated, in parallel, into a single allocation.
+	 */
+	NAVVOLUME_API TArray<FMortonCode> MergeUnique(TArray<TArray<FMortonCode>>&& Runs);
+} // namespace NavVolume::Sort
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ProfilingDebugging/CountersTrace.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include <atomic>
+
+/** Running totals of every build, shown as counters in Unreal Insights. */
+TRACE_DECLARE_INT_COUNTER_EXTERN(NavVolume_VoxelsTested);
+TRACE_DECLARE_INT_COUNTER_EXTERN(NavVolume_VoxelsEmitted);
+TRACE_DECLARE_INT_COUNTER_EXTERN(NavVolume_DuplicateVoxels);
+
+/** What a build or update of a volume did and where its time went - kept with the volume it produced. */
+struct FNavVolumeBuildStats
+{
+	int32 NumComponents = 0; // Navigation relevant overlaps that were voxelized
+	int32 NumShapes = 0;
+	int32 NumBins = 0;
+	int32 NumVoxelizeTasks = 0;
+
+	int64 NumVoxelsTested = 0; // Voxels of each shape's range within each bin - the work handed to the voxelizers
+	int64 NumVoxelsEmitted = 0; // Voxels the shapes produced, including voxels another shape of the bin produced first
+	int64 NumDuplicateVoxels = 0; // Voxels dropped as another shape of the bin already produced them
+	int64 NumLeaves = 0; // Unique leaf codes after the merge
+
+	int32 NumTilesBuilt = 0;
+	TArray<int32> NodesPerLevel; // Summed over the tiles built
+
+	int64 NumRunAllocations = 0; // Allocations of the voxelizers' leaf runs - one per run when the bin estimates hold
+	int64 PeakCodeBytes = 0; // Every run plus the merged codes, the most the merge holds at once
+	uint64 PeakUsedPhysical = 0; // Peak resident memory of the process once the merge is done
+
+	double OverlapSeconds = 0.0; // Overlap query and binning, on the thread that launched the build
+	double VoxelizeSeconds = 0.0; // Summed over the voxelizer tasks
+	double MergeSeconds = 0.0;
+	double OctreeSeconds = 0.0;
+
+	FORCEINLINE double GetDuplicateRatio() const
+	{
+		return NumVoxelsEmitted > 0 ? static_cast<double>(NumDuplicateVoxels) / NumVoxelsEmitted : 0.0;
+	}
+
+	void Log() const
+	{
+		UE_LOG(LogTemp, Log, TEXT("NavVolume build: %d components, %d shapes, %d bins, %d tasks, %d tiles built"),
+			NumComponents, NumShapes, NumBins, NumVoxelizeTasks, NumTilesBuilt);
+		UE_LOG(LogTemp, Log, TEXT("NavVolume build: %lld voxels tested, %lld emitted (%.1f%% duplicate), %lld leaves"),
+			NumVoxelsTested, NumVoxelsEmitted, GetDuplicateRatio() * 100.0, NumLeaves);
+		UE_LOG(LogTemp, Log, TEXT("NavVolume build: overlaps %.2f ms, voxelize %.2f ms (all tasks), merge %.2f ms, octrees %.2f ms"),
+			OverlapSeconds * 1000.0, VoxelizeSeconds * 1000.0, MergeSeconds * 1000.0, OctreeSeconds * 1000.0);
+		UE_LOG(LogTemp, Log, TEXT("NavVolume build: %lld run allocations, %.1f MiB of codes at peak, %.1f MiB peak physical memory"),
+			NumRunAllocations, PeakCodeBytes / (1024.0 * 1024.0), PeakUsedPhysical / (1024.0 * 1024.0));
+
+		for (int32 Level = 0; Level < NodesPerLevel.Num(); ++Level)
+		{
+			UE_LOG(LogTemp, Log, TEXT("NavVolume build: level %d, %d nodes"), Level, NodesPerLevel[Level]);
+		}
+	}
+};
+
+namespace NavVolume::Stats
+{
+	/** Totals the voxelizer tasks of one build add to as each one finishes - read once every task is done. */
+	struct FVoxelizeCounters
+	{
+		std::atomic<int64> NumVoxelsEmitted = 0;
+		std::atomic<int64> NumDuplicateVoxels = 0;
+		std::atomic<uint64> VoxelizeCycles = 0;
+		std::atomic<int64> NumRunAllocations = 0;
+		std::atomic<int64> RunBytes = 0;
+
+		void CopyTo(FNavVolumeBuildStats& Stats) const
+		{
+			Stats.NumVoxelsEmitted = NumVoxelsEmitted.load();
+			Stats.NumDuplicateVoxels = NumDuplicateVoxels.load();
+			Stats.VoxelizeSeconds = FPlatformTime::ToSeconds64(VoxelizeCycles.load());
+			Stats.NumRunAllocations = NumRunAllocations.load();
+			Stats.PeakCodeBytes = RunBytes.load();
+		}
+	};
+} // namespace NavVolume::Stats
@@ -7,108 +7,38 @@
 
 #include "Tasks/Task.h"
 #include "Tasks/Pipe.h"
-#include "Algo/Unique.h"
+#include "Async/Future.h"
+#include "Containers/Ticker.h"
+#include "Components/SceneComponent.h"
 #include "Subsystems/WorldSubsystem.h"
 
 #include "NavVolumeVoxel.h"
 #include "NavVolumeMorton.h"
 #include "NavVolumeOctree.h"
+#include "NavVolumeSort.h"
+#include "NavVolumePathfinding.h"
+#include "NavVolumeTiles.h"
+#include "NavVolumeBroadPhase.h"
+#include "NavVolumeStats.h"
 
 #include "NavVolumeSubsystem.generated.h"
 
 namespace NavVolume::Task
 {
-	using namespace NavVolume::Voxel;
-	using namespace NavVolume::Morton;
-	using namespace UE::Tasks;
-
-	template<int32 N>
-	using TMakeIndexSequence = TMakeIntegerSequence<int32, N>; // Can't find a UE5 alias for std::make_index_sequence
-
-	template<int32... Indices>
-	using TIndexSequence = TIntegerSequence<int32, Indices...>;
+	/** Options shared by every voxelizer of a build. */
+	struct FVoxelizerSettings
+	{
+		/** Blocks proven inside a shape become a single solid octree node instead of every voxel they cover. */
+		bool bSolidInterior = true;
 
-	template<int32 VoxelSize, typename... ArgTypes>
-	struct TVoxelizer;
+		/** Edge length of a voxel in world units - one of SupportedVoxelSizes, each volume can use a different one. */
+		int32 VoxelSize = 32;
 
-	template<int32 VoxelSize>
-	struct TVoxelizer<VoxelSize>
-	{
-		using FReturnType = TArray<FMortonCode>;
-		using FTaskHandle = TTask<FReturnType>;
-		
-		template<typename TransformType, typename BoundsType, typename... ArgTypes>
-		static decltype(auto) MakeVoxelizer(TransformType&& InTransform, BoundsType&& InBounds, ArgTypes&&... InArgs)
-		{
-			return TVoxelizer<VoxelSize, TransformType, BoundsType, ArgTypes...>(
-				Forward<TransformType>(InTransform),
-				Forward<BoundsType>(InBounds),
-				ForwardAsTuple(Forward<ArgTypes>(InArgs)...) // This should preserve lvalue and rvalues
-			);
-		}
-
-		template<typename TransformType, typename BoundsType, typename... ArgTypes>
-		static FORCEINLINE FTaskHandle LaunchVoxelizerAsync(TransformType&& InTransform, BoundsType&& InBounds, ArgTypes&&... InArgs)
-		{
-			auto Voxelizer = MakeVoxelizer(
-				Forward<TransformType>(InTransform),
-				Forward<BoundsType>(InBounds),
-				Forward<ArgTypes>(InArgs)...
-			);
-
-			return Launch(UE_SOURCE_LOCATION, MoveTemp(Voxelizer));
-		}
-
-		template<typename TransformType, typename BoundsType, typename... ArgTypes>
-		static FORCEINLINE FReturnType LaunchVoxelizer(TransformType&& InTransform, BoundsType&& InBounds, ArgTypes&&... InArgs)
-		{
-			auto Voxelizer = MakeVoxelizer(
-				Forward<TransformType>(InTransform),
-				Forward<BoundsType>(InBounds),
-				Forward<ArgTypes>(InArgs)...
-			);
-
-			return Voxelizer();
-		}
-	};
-	
-	template<int32 VoxelSize, typename TransformType, typename BoundsType, typename... ArgTypes>
-	struct TVoxelizer<VoxelSize, TransformType, BoundsType, ArgTypes...>
-	{
-		/** Encodes each voxel-collider intersection as a quantized morton code. */
-		TArray<FMortonCode> operator()()
-		{
-			MortonCodes.Reset(); // Prepare for re-use as the data is being moved
-			Execute(TMakeIndexSequence<TTupleArity<decltype(Args)>::Value>());
-			return MoveTemp(MortonCodes);
-		}
-
-	private:
-		friend struct TVoxelizer<VoxelSize>;
-		
-		/** Constructs a TVoxelizer with type forwarding such that it can support pass-by-reference or pass-by-value for each argument. */
-		TVoxelizer(TransformType&& InTransform, BoundsType&& InBounds, TTuple<ArgTypes...>&& InArgs)
-			: Transform(Forward<TransformType>(InTransform))
-			, Bounds(Forward<BoundsType>(InBounds))
-			, Args(MoveTemp(InArgs)) { } 
-
-		/** Operates as a 'for each' loop on tuple values calling NavVolume::Voxel::Voxelize on each type. */
-		template<size_t... Indices>
-		void Execute(TIndexSequence<Indices...>) 
-		{
-			const auto EncodeVoxel = [&](const FIntVector& WorldPosition)
-			{
-				const FMortonCode MortonCode = EncodeMorton(QuantizeVoxel<VoxelSize>(WorldPosition));
-				MortonCodes.Add(MortonCode);
-			};
-			
-			(Voxelize<VoxelSize>(Args.template Get<Indices>(), Forward<TransformType>(Transform), Forward<BoundsType>(Bounds), EncodeVoxel), ...);
-		}
-		
-		TransformType Transform;
-		BoundsType Bounds;
-		TTuple<ArgTypes...> Args;
-		TArray<FMortonCode> MortonCodes;
+		/** Radii in world units of agents larger than a point - each gets its own octree with obstacles grown by the radius.
+		 *	They are derived from the codes of the point sized volume, so the geometry is only queried and voxelized once.
+		 *	Radii over a tile (VoxelSize << TileLog2Size) are skipped with a warning, agents that large find no volume.
+		 */
+		TArray<float> AgentRadii;
 	};
 }
 
@@ -121,10 +51,27 @@ class NAVVOLUME_API UNavVolumeSubsystem : public UWorldSubsystem
 	GENERATED_BODY()
 
 public:
-	static constexpr int32 VoxelSize = 32;
+	/** Voxel size of volumes that don't ask for another one. */
+	static constexpr int32 DefaultVoxelSize = 32;
+	
+	/** Volumes are split into tiles of 2^TileLog2Size voxels per axis that build, update and stream independently. */
+	static constexpr int32 TileLog2Size = 7;
 	
-	using FSparseVoxelOctree = NavVolume::Octree::TSparseVoxelOctree<VoxelSize>;
-	using FVoxelizer = NavVolume::Task::TVoxelizer<VoxelSize>;
+	static constexpr NavVolume::Octree::EOctreeLayout OctreeLayout = NavVolume::Octree::EOctreeLayout::BrickLeaves | NavVolume::Octree::EOctreeLayout::LevelCodes
+		| NavVolume::Octree::EOctreeLayout::NeighbourLinks;
+	
+	template<int32 VoxelSize>
+	using TTiledOctree = NavVolume::Tile::TTiledVoxelOctree<VoxelSize, OctreeLayout>;
+	
+	using FVoxelizeTask = UE::Tasks::TTask<NavVolume::Octree::FOctreeCodes>;
+	using FVolumePtr = TSharedPtr<const NavVolume::Tile::INavigableVolume>;
+	using FBuildTask = UE::Tasks::TTask<FVolumePtr>;
+	using FPathResult = NavVolume::Path::FPathResult;
+
+	DECLARE_MULTICAST_DELEGATE_TwoParams(FOnNavigableVolumeBuilt, const FBox& /** WorldBounds */, FVolumePtr /** Volume */);
+
+	/** Broadcast on the game thread whenever a build, update or streaming change of a volume has finished - the point sized volume only. */
+	FOnNavigableVolumeBuilt OnNavigableVolumeBuilt;
 	
 	TArray<FOverlapResult> GetBoxOverlaps(const FVector& Center, const FVector& Extents, const FQuat& Rotation, const ECollisionChannel Channel)
 	{
@@ -137,46 +84,186 @@ public:
 	{
 		return GetBoxOverlaps(AABB.GetCenter(), AABB.GetExtent(), FQuat::Identity, Channel);
 	}
-	
-	void CreateNavigableVolume(const FBox& WorldBounds)
+
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	/** Launches the build as a chain of tasks (voxelize -> merge -> tiles) and returns straight away.
+	 *	Every tile of the bounds is loaded, the octrees of tiles with geometry are built in parallel.
+	 *	The returned task acts as a future for the volume, it is also published to the game thread through OnNavigableVolumeBuilt.
+	 *	With a CookedFilename the volume is loaded from that file instead when it was saved for the same geometry and format,
+	 *	otherwise it is built and editor worlds save it there for games to load. Whether it is current is found on a worker.
+	 *	Settings.VoxelSize picks the resolution, volumes of different resolutions are kept side by side.
+	 */
+	FBuildTask CreateNavigableVolume(const FBox& WorldBounds, const NavVolume::Task::FVoxelizerSettings& Settings = {}, const FString& CookedFilename = FString());
+
+	/** Forgets the volume built for the bounds - queries already running keep their octree. */
+	void RemoveNavigableVolume(const FBox& WorldBounds);
+
+	/** Queues a region whose geometry changed (e.g. the old and new bounds of a moved obstacle).
+	 *	Every region marked in a frame is rebuilt on the next tick - only the overlaps inside it are voxelized again and the result is
+	 *	spliced into the volume's existing codes. Navigation relevant components mark themselves as they are registered, unregistered,
+	 *	change collision or move (movable ones, or any in the editor).
+	 */
+	void MarkDirty(const FBox& DirtyBounds);
+
+	/** Moves a volume to new bounds. Tiles sit on a world aligned grid, so tiles the new bounds still touch are kept, tiles it left are
+	 *	dropped and only the region it uncovered is voxelized.
+	 */
+	void MoveNavigableVolume(const FBox& OldBounds, const FBox& NewBounds);
+
+	/** Builds the tiles of a region that just streamed in - tiles are voxelized whole since nothing of them was loaded before. */
+	void LoadNavigableRegion(const FBox& RegionBounds);
+
+	/** Drops the tiles inside a region that streamed out, tiles it only partly covers are updated as a dirty region instead. */
+	void UnloadNavigableRegion(const FBox& RegionBounds);
+
+	/** The latest published volume whose bounds contain the position, null if there is none.
+	 *	With an AgentRadius, the smallest agent profile of that volume that fits the agent - null if none of them does.
+	 */
+	FVolumePtr FindNavigableVolume(const FVector& Position, const float AgentRadius = 0.f) const;
+
+	/** Bounds of the first published volume, invalid if none has been built yet. */
+	FORCEINLINE FBox GetNavigableBounds() const
 	{
-		TArray<FOverlapResult> Overlaps = GetBoxOverlaps(WorldBounds, ECC_WorldStatic);
-		TArray<FVoxelizer::FTaskHandle> TaskHandles;
-		TaskHandles.Reserve(Overlaps.Num());
-		
-		for (const FOverlapResult& Overlap : Overlaps)
-		{
-			INavRelevantInterface* Interface = Cast<INavRelevantInterface>(Overlap.Component);
-			
-			if (Interface != nullptr && Interface->IsNavigationRelevant())
-			{
-				const FKAggregateGeom& AggGeom = Interface->GetNavigableGeometryBodySetup()->AggGeom;
-				
-				FVoxelizer::FTaskHandle TaskHandle = FVoxelizer::LaunchVoxelizerAsync(
-					Interface->GetNavigableGeometryTransform(),
-					Interface->GetNavigationBounds(),
-					AggGeom.BoxElems, AggGeom.ConvexElems, AggGeom.SphereElems, AggGeom.SphylElems
-				);
-				
-				TaskHandles.Add(TaskHandle);
-			}
-		}
-
-		// This is all just temporary - it's a huge sync point
-		// Can be launched as a task with TaskHandles as a dependency 
-		FVoxelizer::FReturnType MortonCodes;
-		
-		for (int32 Index = 0; Index < TaskHandles.Num(); ++Index)
-		{
-			FVoxelizer::FReturnType TempMortonCodes = TaskHandles[Index].GetResult();
-			MortonCodes.Append(MoveTemp(TempMortonCodes));
-		}
-					
-		MortonCodes.Sort();
-		MortonCodes.SetNum(Algo::Unique(MortonCodes));
-		UE_LOG(LogTemp, Warning, TEXT("Morton Codes: %d"), MortonCodes.Num());
-		
-		const FSparseVoxelOctree Octree(MoveTemp(MortonCodes));
-		Octree.DebugDraw(GetWorld());
+		return NavigableVolumes.IsEmpty() ? FBox(ForceInit) : NavigableVolumes[0].WorldBounds;
 	}
+
+	/** Searches for a path on a worker thread - the future is set once the search is done, failed if no volume contains Start. */
+	TFuture<FPathResult> FindPathAsync(const FVector& Start, const FVector& End, const NavVolume::Path::FPathSettings& Settings = {});
+
+	/** Searches for many paths at once (e.g. every agent of a frame) as one task per worker rather than one task per path.
+	 *	Each request runs against the volume that contains its start when this is called, later rebuilds don't affect it.
+	 */
+	TArray<TFuture<FPathResult>> FindPathsAsync(TConstArrayView<NavVolume::Path::FPathRequest> Requests, const NavVolume::Path::FPathSettings& Settings = {});
+
+	/** Line of sight against the octree of the volume containing Start - clear if there is none. */
+	NavVolume::Voxel::FRaycastHit Raycast(const FVector& Start, const FVector& End, const float AgentRadius = 0.f) const;
+
+	/** Casts many segments at once (e.g. every visibility check of a frame) in parallel across the workers and waits for them.
+	 *	Each segment runs against the volume that contains its start - OutHits must be as long as Requests.
+	 */
+	void RaycastBatch(TConstArrayView<NavVolume::Voxel::FRaycastRequest> Requests, TArrayView<NavVolume::Voxel::FRaycastHit> OutHits, const float AgentRadius = 0.f) const;
+
+private:
+	/** Voxelizes the bounds, then splits the codes by tile and builds every tile. */
+	template<int32 VoxelSize>
+	FBuildTask LaunchBuild(const FBox& WorldBounds, const NavVolume::Task::FVoxelizerSettings& Settings);
+
+	/** What identifies the geometry of a navigation relevant component - read on the game thread, hashed on a worker. */
+	struct FGeometrySource
+	{
+		FMatrix Transform;
+		FBox NavigationBounds;
+		FGuid Guid; // Of the body setup, or of the heightfield of a landscape - both change whenever their collision does
+	};
+
+	/** Hashes the sources of a cooked file on a worker and loads its tiles if it was saved for them.
+	 *	Falls back to a build (saved again by editor worlds) if the file is stale or turns out to be unreadable - the returned task
+	 *	then completes with the built volume.
+	 */
+	template<int32 VoxelSize>
+	FBuildTask LaunchLoadCooked(const FBox& WorldBounds, const NavVolume::Task::FVoxelizerSettings& Settings, const FString& Filename, TArray<FGeometrySource>&& Sources);
+
+	/** Saves a volume once its task is done, tagged with the hash of the geometry it was built from. */
+	void LaunchSaveCooked(const FString& Filename, const uint64 GeometryHash, const FBuildTask& VolumeTask);
+
+	/** Sources of every navigation relevant overlap of the bounds - no shapes or triangles are read. */
+	TArray<FGeometrySource> GatherGeometrySources(const FBox& WorldBounds);
+
+	/** Hash of every input of a build of the bounds - a cooked file saved with a different hash is stale. */
+	static uint64 HashGeometrySources(TArray<FGeometrySource>&& Sources, const FBox& WorldBounds, const NavVolume::Task::FVoxelizerSettings& Settings);
+
+	/** Bins the shapes of every navigation relevant overlap of the bounds and launches voxelizers over runs of bins,
+	 *	optionally voxelizing only the part of each overlap inside the bounds.
+	 *	OutStats gets what is known at launch, the voxelizers add their totals to Counters as they finish.
+	 */
+	template<int32 VoxelSize>
+	TArray<FVoxelizeTask> LaunchVoxelizers(const FBox& WorldBounds, const NavVolume::Task::FVoxelizerSettings& Settings, const bool bClipToBounds,
+		FNavVolumeBuildStats& OutStats, const TSharedPtr<NavVolume::Stats::FVoxelizeCounters>& Counters);
+
+	/** Publishes a volume, or the agent profile of AgentRadius, to the game thread once its task is done.
+	 *	Returns the id the publish is tagged with - ids grow with every launch, so they order the builds of every volume.
+	 */
+	uint64 LaunchPublish(const FBox& WorldBounds, const FBuildTask& VolumeTask, const float AgentRadius = 0.f);
+
+	/** Re-voxelizes a region of a volume, splices it into the codes of the tiles it touches and rebuilds only those tiles.
+	 *	With bLoadTiles, tiles that aren't loaded are built too (the region is grown to whole tiles), otherwise they are left unloaded.
+	 */
+	void UpdateNavigableVolume(const FBox& WorldBounds, const FBox& DirtyBounds, const bool bLoadTiles);
+
+	template<int32 VoxelSize>
+	FBuildTask LaunchUpdate(const FBox& DirtyBounds, const NavVolume::Task::FVoxelizerSettings& Settings, const FBuildTask& PreviousTask, const bool bLoadTiles);
+
+	/** Drops the tiles of a volume that lie completely inside a region. */
+	template<int32 VoxelSize>
+	FBuildTask LaunchUnload(const FBox& WorldBounds, const FBox& RegionBounds, const FBuildTask& PreviousTask);
+
+	/** Drops the tiles of a volume that don't touch its bounds, e.g. after it moved. */
+	template<int32 VoxelSize>
+	FBuildTask LaunchClip(const FBox& WorldBounds, const FBuildTask& PreviousTask);
+
+	void OnLevelAddedToWorld(ULevel* Level, UWorld* World);
+	void OnLevelRemovedFromWorld(ULevel* Level, UWorld* World);
+
+	/** Marks the bounds of a navigation relevant component dirty as its physics state is created or destroyed - on registering and
+	 *	unregistering, and whenever its collision changes. Components of levels streaming in or out are left to their whole level.
+	 */
+	void OnComponentPhysicsStateChanged(UActorComponent* Component, const bool bCreated);
+
+	/** Marks the old and new bounds of a tracked component dirty once it has moved. */
+	void OnComponentTransformUpdated(USceneComponent* Component, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport);
+
+	/** Rebuilds every region marked since the last flush - ticked once after the first MarkDirty of a frame. */
+	void FlushDirtyRegions();
+	
+	/** Final stage of every build and update - always runs on the game thread. */
+	void PublishNavigableVolume(const FBox& WorldBounds, const float AgentRadius, const uint64 BuildId, FVolumePtr Volume);
+
+	/** Octree of a volume for agents of a radius, built from the volume's own octree rather than the geometry. */
+	struct FAgentProfile
+	{
+		float AgentRadius = 0.f;
+		FVolumePtr Volume;
+		FBuildTask Latest;
+		uint64 PublishedId = 0;
+	};
+
+	struct FNavigableVolume
+	{
+		FBox WorldBounds;
+		FVolumePtr Volume;
+		NavVolume::Task::FVoxelizerSettings Settings;
+
+		/** The newest build or update, which may still be running - the next update starts from its result. */
+		FBuildTask Latest;
+
+		/** Publish ids of the last full build and of the published volume - a volume launched before either of them is stale when it finishes. */
+		uint64 BuildId = 0;
+		uint64 PublishedId = 0;
+
+		/** One per radius of Settings.AgentRadii, smallest first. */
+		TArray<FAgentProfile> Profiles;
+	};
+
+	FNavigableVolume& FindOrAddNavigableVolume(const FBox& WorldBounds);
+
+	/** Rebuilds the agent profiles of a volume from its latest state - only the tiles within reach of DirtyBounds, or all of them if it is invalid. */
+	void LaunchAgentProfiles(FNavigableVolume& Volume, const FBox& DirtyBounds);
+
+	/** Grows the obstacles of the tiles of BaseTask within reach of DirtyBounds by Radius voxels, on top of the previous state of the profile. */
+	template<int32 VoxelSize>
+	FBuildTask LaunchDilate(const FBuildTask& BaseTask, const FBuildTask& PreviousTask, const FBox& DirtyBounds, const int32 Radius, const bool bCollapseSolids);
+
+	TArray<FBox> DirtyRegions;
+	FTSTicker::FDelegateHandle FlushDirtyHandle;
+
+	/** Components that can move, with the navigation bounds they were last marked at. */
+	TMap<TWeakObjectPtr<USceneComponent>, FBox> TrackedComponents;
+
+	/** Id of the last publish launched - see LaunchPublish. */
+	uint64 LastBuildId = 0;
+
+	/** Volumes kept for queries, one per bounds - only touched on the game thread. */
+	TArray<FNavigableVolume> NavigableVolumes;
 };
\ No newline at end of file
@@ -0,0 +1,757 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "NavVolumeOctree.h"
+#include "NavVolumePathfinding.h"
+#include "NavVolumeStats.h"
+
+/** A volume split into fixed size tiles, each one an independent octree.
+ *	A tile's key is the leaf code of any of its voxels >> 3 * TileLog2Size, so the tiles of a volume are found from the high morton bits
+ *	and every tile can be built, replaced or dropped on its own.
+ */
+namespace NavVolume::Tile
+{
+	using namespace NavVolume::Octree;
+
+	/** Splits the codes of a volume by tile - solid blocks larger than a tile become one solid block per tile they cover. */
+	inline TMap<FMortonCode, FOctreeCodes> SplitTiles(FOctreeCodes&& Codes, const int32 TileLog2Size)
+	{
+		TRACE_CPUPROFILER_EVENT_SCOPE(NavVolume::SplitTiles);
+		TMap<FMortonCode, FOctreeCodes> Tiles;
+
+		// Leaves are sorted so the leaves of a tile are a contiguous run
+		for (int32 Begin = 0, End = 0; Begin < Codes.Leaves.Num(); Begin = End)
+		{
+			const FMortonCode Key = Codes.Leaves[Begin] >> (3 * TileLog2Size);
+			for (End = Begin; End < Codes.Leaves.Num() && Codes.Leaves[End] >> (3 * TileLog2Size) == Key; ++End);
+
+			Tiles.FindOrAdd(Key).Leaves.Append(Codes.Leaves.GetData() + Begin, End - Begin);
+		}
+
+		for (int32 Level = 0; Level < Codes.Solids.Num(); ++Level)
+		{
+			const int32 Log2Size = Level + 1;
+
+			for (const FMortonCode Code : Codes.Solids[Level])
+			{
+				if (Log2Size <= TileLog2Size)
+				{
+					FOctreeCodes& Tile = Tiles.FindOrAdd(Code >> (3 * (TileLog2Size - Log2Size)));
+					Tile.Solids.SetNum(FMath::Max(Tile.Solids.Num(), Level + 1));
+					Tile.Solids[Level].Add(Code);
+					continue;
+				}
+
+				// The node code of a tile sized block is the tile's key
+				const int32 NumTiles = 1 << (3 * (Log2Size - TileLog2Size));
+
+				for (int32 TileIndex = 0; TileIndex < NumTiles; ++TileIndex)
+				{
+					const FMortonCode Key = (Code << (3 * (Log2Size - TileLog2Size))) + TileIndex;
+					FOctreeCodes& Tile = Tiles.FindOrAdd(Key);
+					Tile.Solids.SetNum(FMath::Max(Tile.Solids.Num(), TileLog2Size));
+					Tile.Solids[TileLog2Size - 1].Add(Key);
+				}
+			}
+		}
+
+		Codes = FOctreeCodes();
+		return Tiles;
+	}
+
+	/** Keys of every tile that overlaps the bounds. */
+	template<int32 VoxelSize>
+	TArray<FMortonCode> GetTileKeys(const FBox& WorldBounds, const int32 TileLog2Size)
+	{
+		FIntVector VoxelMin, VoxelMax;
+		GetVoxelRange<VoxelSize>(WorldBounds, VoxelMin, VoxelMax);
+
+		const int32 TileMask = ~((1 << TileLog2Size) - 1);
+		TArray<FMortonCode> Keys;
+
+		for (int32 X = VoxelMin.X & TileMask; X <= VoxelMax.X; X += 1 << TileLog2Size)
+		for (int32 Y = VoxelMin.Y & TileMask; Y <= VoxelMax.Y; Y += 1 << TileLog2Size)
+		for (int32 Z = VoxelMin.Z & TileMask; Z <= VoxelMax.Z; Z += 1 << TileLog2Size)
+		{
+			Keys.Add(EncodeMorton(X, Y, Z) >> (3 * TileLog2Size));
+		}
+
+		return Keys;
+	}
+
+	/** A tiled octree of any voxel size, so volumes of different resolutions can be held together.
+	 *	Every call dispatches once to the octree compiled for the size - the loops below it are never virtual.
+	 */
+	class INavigableVolume
+	{
+	public:
+		virtual ~INavigableVolume() = default;
+
+		virtual int32 GetVoxelSize() const = 0;
+		virtual NavVolume::Path::FPathResult FindPath(const FVector& Start, const FVector& End, const NavVolume::Path::FPathSettings& Settings) const = 0;
+		virtual FRaycastHit Raycast(const FVector& Start, const FVector& End) const = 0;
+		
+		/** Casts every ray in parallel across the workers - OutHits must be as long as Requests. */
+		virtual void RaycastBatch(TConstArrayView<FRaycastRequest> Requests, TArrayView<FRaycastHit> OutHits) const = 0;
+		virtual void Serialize(FArchive& Ar) = 0;
+		virtual SIZE_T GetAllocatedSize() const = 0;
+		virtual void LogMemoryUsage() const = 0;
+
+		/** Draws the octree of every tile, or with bBuiltTilesOnly only the tiles the build that produced this state built.
+		 *	Lines are persistent if LifeTime is negative, otherwise they expire after LifeTime seconds.
+		 */
+		virtual void DebugDraw(const UWorld* World, const bool bBuiltTilesOnly, const float LifeTime) const = 0;
+
+		/** Stats of the build or update that produced this state of the volume - empty for a volume loaded from a file. */
+		virtual const FNavVolumeBuildStats& GetBuildStats() const = 0;
+	};
+
+	/** An immutable set of loaded tiles - updates copy the set and share every tile they don't replace, so a published set never changes
+	 *	under a query and memory only grows with the tiles that have geometry. A tile of the bounds without geometry isn't stored at all,
+	 *	searches treat it as free space unless its streaming cell is unloaded.
+	 */
+	template<int32 VoxelSize, EOctreeLayout Layout>
+	class TTiledVoxelOctree final : public INavigableVolume
+	{
+	public:
+		using FOctree = TSparseVoxelOctree<VoxelSize, Layout>;
+		using FOctreePtr = TSharedPtr<const FOctree>;
+
+		static constexpr int32 NumDirections = FOctree::NumDirections;
+		static constexpr bool bNeighbourLinks = FOctree::bNeighbourLinks;
+		static constexpr bool bBrickLeaves = FOctree::bBrickLeaves;
+
+		/** A loaded tile with geometry. */
+		struct FTile
+		{
+			FMortonCode Key = 0;
+			FOctreePtr Octree;
+		};
+
+		explicit TTiledVoxelOctree(const int32 InTileLog2Size)
+			: TileLog2Size(InTileLog2Size)
+		{
+			check(TileLog2Size > FOctree::LeafLog2Size && TileLog2Size <= 20 && 3 * (21 - TileLog2Size) <= FNodeLink::TileKeyBits);
+		}
+
+		virtual int32 GetVoxelSize() const override
+		{
+			return VoxelSize;
+		}
+
+		virtual NavVolume::Path::FPathResult FindPath(const FVector& Start, const FVector& End, const NavVolume::Path::FPathSettings& Settings) const override
+		{
+			if constexpr (bNeighbourLinks)
+			{
+				return NavVolume::Path::TPathfinder<TTiledVoxelOctree>::FindPath(*this, Start, End, Settings);
+			}
+			else
+			{
+				checkNoEntry(); // Searches need EOctreeLayout::NeighbourLinks
+				return {};
+			}
+		}
+
+		/** Same as TSparseVoxelOctree::Raycast across the tiles the segment passes through, walked in order with a DDA over the tile grid.
+		 *	An empty tile is passed straight through, a tile outside the bounds or unloaded blocks the segment as it does searches.
+		 */
+		virtual FRaycastHit Raycast(const FVector& Start, const FVector& End) const override
+		{
+			const FVoxelRay Ray = FVoxelRay::Make<VoxelSize>(Start, End);
+			const double TileSize = 1 << TileLog2Size;
+
+			FIntVector Tile;
+			FIntVector Step;
+			FVector NextTime; // Where the segment crosses into the next tile on each axis
+			FVector DeltaTime; // Time taken to cross a whole tile on each axis
+
+			for (int32 Axis = 0; Axis < 3; ++Axis)
+			{
+				Tile[Axis] = FMath::FloorToInt(Ray.Origin[Axis]) >> TileLog2Size;
+				Step[Axis] = Ray.Direction[Axis] > 0.0 ? 1 : Ray.Direction[Axis] < 0.0 ? -1 : 0;
+				NextTime[Axis] = Step[Axis] == 0 ? UE_BIG_NUMBER : ((Tile[Axis] + (Step[Axis] > 0)) * TileSize - Ray.Origin[Axis]) * Ray.InvDirection[Axis];
+				DeltaTime[Axis] = Step[Axis] == 0 ? UE_BIG_NUMBER : TileSize * FMath::Abs(Ray.InvDirection[Axis]);
+			}
+
+			FRaycastHit Hit;
+			
+			for (double Time = 0.0; Time <= 1.0;)
+			{
+				const FMortonCode Key = GetTileKey(Tile * (1 << TileLog2Size));
+				const FTile* CurTile = FindTile(Key);
+				double HitTime = Time;
+
+				if (CurTile != nullptr ? CurTile->Octree->Raycast(Ray, HitTime) : !IsEmptyTile(Key))
+				{
+					Hit.bBlocked = true;
+					Hit.Time = HitTime;
+					Hit.Location = FMath::Lerp(Start, End, HitTime);
+					return Hit;
+				}
+
+				const int32 Axis = NextTime.X < NextTime.Y ? (NextTime.X < NextTime.Z ? 0 : 2) : (NextTime.Y < NextTime.Z ? 1 : 2);
+				Time = NextTime[Axis];
+				Tile[Axis] += Step[Axis];
+				NextTime[Axis] += DeltaTime[Axis];
+			}
+
+			Hit.Location = End;
+			return Hit;
+		}
+
+		virtual void RaycastBatch(TConstArrayView<FRaycastRequest> Requests, TArrayView<FRaycastHit> OutHits) const override
+		{
+			TRACE_CPUPROFILER_EVENT_SCOPE(NavVolume::RaycastBatch);
+			check(Requests.Num() == OutHits.Num());
+
+			// A ray is short work - batches keep the scheduling cost below the cost of the rays
+			ParallelFor(TEXT("NavVolume.RaycastBatch"), Requests.Num(), 64, [&](const int32 Index)
+			{
+				OutHits[Index] = Raycast(Requests[Index].Start, Requests[Index].End);
+			});
+		}
+
+		FORCEINLINE int32 GetTileLog2Size() const
+		{
+			return TileLog2Size;
+		}
+
+		FORCEINLINE FMortonCode GetTileKey(const FIntVector& Voxel) const
+		{
+			return EncodeMorton(Voxel) >> (3 * TileLog2Size);
+		}
+
+		FORCEINLINE FBox GetTileBounds(const FMortonCode Key) const
+		{
+			return FOctree::GetCellBounds(Key << (3 * TileLog2Size), TileLog2Size);
+		}
+
+		FORCEINLINE const FTile* FindTile(const FMortonCode Key) const
+		{
+			const int32* TileIndex = TileIndices.Find(Key);
+			return TileIndex != nullptr ? &Tiles[*TileIndex] : nullptr;
+		}
+
+		FORCEINLINE int32 NumTiles() const
+		{
+			return Tiles.Num();
+		}
+
+		/** Codes a tile would be built from again, e.g. to splice a dirty region into - none for a tile without geometry. */
+		FOctreeCodes GetTileCodes(const FMortonCode Key) const
+		{
+			const FTile* Tile = FindTile(Key);
+			return Tile != nullptr ? Tile->Octree->GetCodes() : FOctreeCodes();
+		}
+
+		/** Tile coordinates of a key - a key is the code of the tile's minimum voxel shifted down, not the code of the coordinates,
+		 *	as codes are offset to encode negative voxels.
+		 */
+		FORCEINLINE FIntVector GetTileCoordinates(const FMortonCode Key) const
+		{
+			const FIntVector TileMin = DecodeMorton(Key << (3 * TileLog2Size));
+			return FIntVector(TileMin.X >> TileLog2Size, TileMin.Y >> TileLog2Size, TileMin.Z >> TileLog2Size);
+		}
+
+		FORCEINLINE bool IsTileInBounds(const FMortonCode Key) const
+		{
+			const FIntVector Tile = GetTileCoordinates(Key);
+			return Tile.X >= MinTile.X && Tile.Y >= MinTile.Y && Tile.Z >= MinTile.Z && Tile.X <= MaxTile.X && Tile.Y <= MaxTile.Y && Tile.Z <= MaxTile.Z;
+		}
+
+		/** Whether a tile without geometry is free space - inside the bounds and not unloaded. */
+		FORCEINLINE bool IsEmptyTile(const FMortonCode Key) const
+		{
+			return IsTileInBounds(Key) && !TileIndices.Contains(Key) && !UnloadedTileKeys.Contains(Key);
+		}
+
+		/** Whether a tile is known - it has geometry, or is free space. */
+		FORCEINLINE bool IsTileLoaded(const FMortonCode Key) const
+		{
+			return TileIndices.Contains(Key) || IsEmptyTile(Key);
+		}
+
+		FORCEINLINE const TSet<FMortonCode>& GetUnloadedTileKeys() const
+		{
+			return UnloadedTileKeys;
+		}
+
+		/** Sets the bounds whose tiles without geometry are free space and forgets the unloaded tiles outside them. */
+		void SetBounds(const FBox& WorldBounds)
+		{
+			FIntVector VoxelMin, VoxelMax;
+			GetVoxelRange<VoxelSize>(WorldBounds, VoxelMin, VoxelMax);
+			
+			MinTile = FIntVector(VoxelMin.X >> TileLog2Size, VoxelMin.Y >> TileLog2Size, VoxelMin.Z >> TileLog2Size);
+			MaxTile = FIntVector(VoxelMax.X >> TileLog2Size, VoxelMax.Y >> TileLog2Size, VoxelMax.Z >> TileLog2Size);
+
+			for (TSet<FMortonCode>::TIterator It(UnloadedTileKeys); It; ++It)
+			{
+				if (!IsTileInBounds(*It))
+				{
+					It.RemoveCurrent();
+				}
+			}
+		}
+
+		/** Takes the bounds and unloaded tiles of another volume, e.g. of the volume a profile is dilated from. */
+		void CopyBounds(const TTiledVoxelOctree& Other)
+		{
+			MinTile = Other.MinTile;
+			MaxTile = Other.MaxTile;
+			UnloadedTileKeys = Other.UnloadedTileKeys;
+		}
+
+		FORCEINLINE const TArray<FTile>& GetTiles() const
+		{
+			return Tiles;
+		}
+
+		/** Builds the octree of every tile in parallel and loads them, replacing loaded tiles with the same key.
+		 *	A tile with no codes is dropped - it is free space from then on, even if it was unloaded before.
+		 */
+		void BuildTiles(TArray<TPair<FMortonCode, FOctreeCodes>>&& TileCodes, const bool bCollapseSolids, FNavVolumeBuildStats* OutStats = nullptr)
+		{
+			TRACE_CPUPROFILER_EVENT_SCOPE(NavVolume::BuildTiles);
+			const double StartTime = FPlatformTime::Seconds();
+			BuiltTileKeys.Reset();
+			
+			TArray<FTile> Built;
+			Built.SetNum(TileCodes.Num());
+
+			// The root of every tile covers the whole tile so neighbours across a seam are always found at the tile's top level
+			const int32 NumTileLevels = TileLog2Size - FOctree::LeafLog2Size;
+
+			ParallelFor(TileCodes.Num(), [&](const int32 Index)
+			{
+				FTile& Tile = Built[Index];
+				FOctreeCodes& Codes = TileCodes[Index].Value;
+				Tile.Key = TileCodes[Index].Key;
+
+				const bool bEmpty = Codes.Leaves.IsEmpty() && !Codes.Solids.ContainsByPredicate([](const TArray<FMortonCode>& Level) { return !Level.IsEmpty(); });
+
+				if (!bEmpty)
+				{
+					Tile.Octree = MakeShared<const FOctree>(MoveTemp(Codes), bCollapseSolids, NumTileLevels);
+				}
+			});
+
+			if (OutStats != nullptr)
+			{
+				OutStats->OctreeSeconds = FPlatformTime::Seconds() - StartTime;
+				OutStats->NumTilesBuilt = Built.Num();
+
+				for (const FTile& Tile : Built)
+				{
+					for (int32 Level = 0; Tile.Octree.IsValid() && Level < Tile.Octree->NumLevels(); ++Level)
+					{
+						OutStats->NodesPerLevel.SetNumZeroed(FMath::Max(OutStats->NodesPerLevel.Num(), Level + 1));
+						OutStats->NodesPerLevel[Level] += Tile.Octree->NumNodes(Level);
+					}
+				}
+			}
+
+			for (FTile& Tile : Built)
+			{
+				BuiltTileKeys.Add(Tile.Key);
+				UnloadedTileKeys.Remove(Tile.Key);
+
+				if (!Tile.Octree.IsValid())
+				{
+					RemoveTile(Tile.Key);
+				}
+				else if (!SetTile(MoveTemp(Tile)))
+				{
+					// Blocked rather than free, its geometry would be missing
+					UE_LOG(LogTemp, Error, TEXT("NavVolume: more than %d tiles with geometry, tile %llu left unloaded"), FNodeLink::MaxNumTiles, Tile.Key);
+					UnloadedTileKeys.Add(Tile.Key);
+				}
+			}
+		}
+
+		/** Builds tiles of this volume from the tiles of another with every obstacle grown by Radius voxels, e.g. for an agent of that size.
+		 *	Tiles that Base doesn't have loaded are skipped, empty tiles of Base are built from the leaves of their neighbours.
+		 */
+		void BuildDilatedTiles(const TTiledVoxelOctree& Base, TConstArrayView<FMortonCode> Keys, const int32 Radius, const bool bCollapseSolids,
+			FNavVolumeBuildStats* OutStats = nullptr)
+		{
+			TRACE_CPUPROFILER_EVENT_SCOPE(NavVolume::BuildDilatedTiles);
+			check(Base.TileLog2Size == TileLog2Size);
+			const double StartTime = FPlatformTime::Seconds();
+			
+			TArray<TPair<FMortonCode, FOctreeCodes>> TileCodes;
+			TSet<FMortonCode> SourceKeys;
+			
+			for (const FMortonCode Key : Keys)
+			{
+				if (!Base.IsTileLoaded(Key))
+				{
+					continue;
+				}
+
+				TileCodes.Emplace(Key, FOctreeCodes());
+				const FIntVector TileMin = DecodeMorton(Key << (3 * TileLog2Size));
+
+				for (int32 X = -1; X <= 1; ++X)
+				for (int32 Y = -1; Y <= 1; ++Y)
+				for (int32 Z = -1; Z <= 1; ++Z)
+				{
+					const FMortonCode SourceKey = GetTileKey(TileMin + FIntVector(X, Y, Z) * (1 << TileLog2Size));
+					if (Base.FindTile(SourceKey) != nullptr) SourceKeys.Add(SourceKey);
+				}
+			}
+
+			// The codes of every tile with geometry that reaches a dilated tile, made once rather than by each of its neighbours
+			TArray<TPair<FMortonCode, FOctreeCodes>> SourceCodes;
+			SourceCodes.Reserve(SourceKeys.Num());
+			for (const FMortonCode Key : SourceKeys) SourceCodes.Emplace(Key, FOctreeCodes());
+
+			ParallelFor(SourceCodes.Num(), [&](const int32 Index)
+			{
+				SourceCodes[Index].Value = Base.GetTileCodes(SourceCodes[Index].Key);
+			});
+
+			TMap<FMortonCode, const FOctreeCodes*> SourceCodesByKey;
+			SourceCodesByKey.Reserve(SourceCodes.Num());
+			for (const TPair<FMortonCode, FOctreeCodes>& Source : SourceCodes) SourceCodesByKey.Add(Source.Key, &Source.Value);
+
+			ParallelFor(TileCodes.Num(), [&](const int32 Index)
+			{
+				TileCodes[Index].Value = GetDilatedTileCodes(SourceCodesByKey, TileCodes[Index].Key, Radius);
+			});
+
+			// Dilating stands in for the merge of a build from geometry
+			if (OutStats != nullptr)
+			{
+				OutStats->MergeSeconds = FPlatformTime::Seconds() - StartTime;
+			}
+
+			BuildTiles(MoveTemp(TileCodes), bCollapseSolids, OutStats);
+		}
+
+		/** Codes of a tile grown by Radius voxels along every axis (see FOctreeCodes::DilateLeaves), from the leaves and solid blocks of the
+		 *	tile and of its neighbours that are within Radius of it. Solid blocks are kept as they are and their face voxels grow along with the
+		 *	leaves - a block through voxel centres can border free space directly. Radius is at most a tile so only the 26 neighbours can reach into it.
+		 *	SourceCodes are the codes of the tiles with geometry by key.
+		 */
+		FOctreeCodes GetDilatedTileCodes(const TMap<FMortonCode, const FOctreeCodes*>& SourceCodes, const FMortonCode Key, const int32 Radius) const
+		{
+			check(Radius >= 0 && Radius <= 1 << TileLog2Size);
+			
+			const FIntVector TileMin = DecodeMorton(Key << (3 * TileLog2Size));
+			const FIntVector GrownMin = TileMin - FIntVector(Radius);
+			const FIntVector GrownMax = TileMin + FIntVector((1 << TileLog2Size) - 1 + Radius);
+			
+			FOctreeCodes Dilated;
+			
+			if (const FOctreeCodes* const* TileCodes = SourceCodes.Find(Key))
+			{
+				Dilated.Leaves = (*TileCodes)->Leaves;
+				Dilated.Solids = (*TileCodes)->Solids;
+			}
+
+			for (int32 X = -1; X <= 1 && Radius > 0; ++X)
+			for (int32 Y = -1; Y <= 1; ++Y)
+			for (int32 Z = -1; Z <= 1; ++Z)
+			{
+				const bool bCenter = X == 0 && Y == 0 && Z == 0;
+				const FOctreeCodes* const* NeighbourCodes = SourceCodes.Find(bCenter ? Key : GetTileKey(TileMin + FIntVector(X, Y, Z) * (1 << TileLog2Size)));
+
+				if (NeighbourCodes == nullptr)
+				{
+					continue;
+				}
+
+				const FOctreeCodes& Neighbour = **NeighbourCodes;
+
+				for (const FMortonCode Leaf : bCenter ? TConstArrayView<FMortonCode>() : TConstArrayView<FMortonCode>(Neighbour.Leaves))
+				{
+					const FIntVector Voxel = DecodeMorton(Leaf);
+					
+					if (Voxel.X >= GrownMin.X && Voxel.Y >= GrownMin.Y && Voxel.Z >= GrownMin.Z && Voxel.X <= GrownMax.X && Voxel.Y <= GrownMax.Y && Voxel.Z <= GrownMax.Z)
+					{
+						Dilated.Leaves.Add(Leaf);
+					}
+				}
+
+				for (int32 Level = 0; Level < Neighbour.Solids.Num(); ++Level)
+				{
+					for (const FMortonCode Code : Neighbour.Solids[Level])
+					{
+						AddSolidFaceVoxels(Code, Level + 1, GrownMin, GrownMax, Dilated.Leaves);
+					}
+				}
+			}
+
+			FOctreeCodes::DilateLeaves(Dilated.Leaves, Radius);
+
+			// Leaves grown into the neighbours belong to their own tiles
+			Dilated.Leaves.RemoveAll([this, Key](const FMortonCode Leaf) { return Leaf >> (3 * TileLog2Size) != Key; });
+			return Dilated;
+		}
+
+		virtual const FNavVolumeBuildStats& GetBuildStats() const override
+		{
+			return BuildStats;
+		}
+
+		void SetBuildStats(FNavVolumeBuildStats&& InBuildStats)
+		{
+			BuildStats = MoveTemp(InBuildStats);
+		}
+
+		/** Loads a tile with geometry - fails once links can't address another tile. */
+		bool SetTile(FTile&& Tile)
+		{
+			if (const int32* TileIndex = TileIndices.Find(Tile.Key))
+			{
+				Tiles[*TileIndex] = MoveTemp(Tile);
+				return true;
+			}
+
+			if (Tiles.Num() >= FNodeLink::MaxNumTiles)
+			{
+				return false;
+			}
+
+			TileIndices.Add(Tile.Key, Tiles.Num());
+			Tiles.Add(MoveTemp(Tile));
+			return true;
+		}
+
+		/** Drops tiles, e.g. after the volume moved away from them - tiles inside the bounds become free space. */
+		void RemoveTiles(TConstArrayView<FMortonCode> Keys)
+		{
+			BuiltTileKeys.Reset();
+			
+			for (const FMortonCode Key : Keys)
+			{
+				RemoveTile(Key);
+			}
+		}
+
+		/** Drops tiles as their streaming cell unloads - searches treat them as blocked until they are built again. */
+		void UnloadTiles(TConstArrayView<FMortonCode> Keys)
+		{
+			RemoveTiles(Keys);
+			UnloadedTileKeys.Append(Keys);
+		}
+
+		/** Saves or loads the bounds, the unloaded tiles and the octree of every tile - loading replaces the tiles that are loaded.
+		 *	Each tile is one allocation per octree array filled by a bulk read, see TSparseVoxelOctree::Serialize for why it isn't a view.
+		 */
+		virtual void Serialize(FArchive& Ar) override
+		{
+			TRACE_CPUPROFILER_EVENT_SCOPE(NavVolume::SerializeTiles);
+			Ar << TileLog2Size << MinTile << MaxTile << UnloadedTileKeys;
+
+			int32 NumSerializedTiles = Tiles.Num();
+			Ar << NumSerializedTiles;
+
+			if (Ar.IsLoading())
+			{
+				Tiles.Reset(NumSerializedTiles);
+				TileIndices.Reset();
+			}
+
+			for (int32 TileIndex = 0; TileIndex < NumSerializedTiles; ++TileIndex)
+			{
+				FTile Tile = Ar.IsLoading() ? FTile() : Tiles[TileIndex];
+				Ar << Tile.Key;
+
+				// Tiles are shared and immutable once built - saving only reads them
+				TSharedPtr<FOctree> Octree = Ar.IsLoading() ? MakeShared<FOctree>() : ConstCastSharedPtr<FOctree>(Tile.Octree);
+				Octree->Serialize(Ar);
+
+				if (Ar.IsLoading())
+				{
+					Tile.Octree = Octree;
+					SetTile(MoveTemp(Tile));
+				}
+			}
+		}
+
+		/** Same as TSparseVoxelOctree::FindLink, with the tile of the position in the link. */
+		FNodeLink FindLink(const FVector& Position) const
+		{
+			const FMortonCode Key = GetTileKey(SnapToVoxelAxis<VoxelSize>(Position) / VoxelSize);
+
+			if (const int32* TileIndex = TileIndices.Find(Key))
+			{
+				return Tiles[*TileIndex].Octree->FindLink(Position).WithTile(*TileIndex);
+			}
+
+			return IsEmptyTile(Key) ? FNodeLink::MakeTile(Key) : FNodeLink();
+		}
+
+		FORCEINLINE bool IsLinkFree(const FNodeLink Link) const
+		{
+			if (Link.GetType() == FNodeLink::EType::Tile)
+			{
+				return true;
+			}
+
+			return Link.IsValid() && Tiles[Link.GetTile()].Octree->IsLinkFree(Link.WithTile(0));
+		}
+
+		FORCEINLINE FBox GetLinkBounds(const FNodeLink Link) const
+		{
+			return Link.GetType() == FNodeLink::EType::Tile ? GetTileBounds(Link.GetTileKey()) : Tiles[Link.GetTile()].Octree->GetLinkBounds(Link.WithTile(0));
+		}
+
+		/** Same as TSparseVoxelOctree::CollectFreeNeighbours - a face on a tile's seam is matched against the same sized cell of the next tile. */
+		void CollectFreeNeighbours(const FNodeLink Link, const int32 Direction, TArray<FNodeLink>& OutLinks) const
+		{
+			FMortonCode CellCode;
+			int32 CellLog2Size;
+
+			if (Link.GetType() == FNodeLink::EType::Tile)
+			{
+				CellCode = Link.GetTileKey() << (3 * TileLog2Size);
+				CellLog2Size = TileLog2Size;
+			}
+			else
+			{
+				const FTile& Tile = Tiles[Link.GetTile()];
+				const FNodeLink LocalLink = Link.WithTile(0);
+				const FNodeLink Neighbour = Tile.Octree->GetNeighbour(LocalLink, Direction);
+
+				if (Neighbour.IsValid())
+				{
+					CollectTileFace(Link.GetTile(), Neighbour, Direction, OutLinks);
+					return;
+				}
+
+				Tile.Octree->GetLinkCell(LocalLink, CellCode, CellLog2Size);
+			}
+
+			// Step the cell across the seam
+			FMortonCode NeighbourCode;
+
+			if (!StepMorton(CellCode >> (3 * CellLog2Size), Direction / 2, Direction & 1, NeighbourCode, 21 - CellLog2Size))
+			{
+				return;
+			}
+
+			NeighbourCode <<= 3 * CellLog2Size;
+			const FMortonCode NeighbourKey = NeighbourCode >> (3 * TileLog2Size);
+			const int32* NeighbourIndex = TileIndices.Find(NeighbourKey);
+
+			if (NeighbourIndex == nullptr)
+			{
+				if (IsEmptyTile(NeighbourKey)) OutLinks.Add(FNodeLink::MakeTile(NeighbourKey));
+				return;
+			}
+
+			CollectTileFace(*NeighbourIndex, Tiles[*NeighbourIndex].Octree->FindLinkAtCode(NeighbourCode, CellLog2Size), Direction, OutLinks);
+		}
+
+		/** Bytes used by the octrees of the loaded tiles. */
+		virtual SIZE_T GetAllocatedSize() const override
+		{
+			SIZE_T AllocatedSize = Tiles.GetAllocatedSize() + TileIndices.GetAllocatedSize() + UnloadedTileKeys.GetAllocatedSize();
+
+			for (const FTile& Tile : Tiles)
+			{
+				if (Tile.Octree.IsValid())
+				{
+					AllocatedSize += Tile.Octree->GetLeafAllocatedSize();
+
+					for (int32 Level = 0; Level < Tile.Octree->NumLevels(); ++Level)
+					{
+						AllocatedSize += Tile.Octree->GetLevelAllocatedSize(Level);
+					}
+				}
+			}
+
+			return AllocatedSize;
+		}
+
+		virtual void LogMemoryUsage() const override
+		{
+			UE_LOG(LogTemp, Log, TEXT("Tiled octree (%d voxels): %d tiles with geometry (%d unloaded), %llu bytes"),
+				VoxelSize, Tiles.Num(), UnloadedTileKeys.Num(), static_cast<uint64>(GetAllocatedSize()));
+		}
+
+		virtual void DebugDraw(const UWorld* World, const bool bBuiltTilesOnly, const float LifeTime) const override
+		{
+#if WITH_EDITOR
+			TRACE_CPUPROFILER_EVENT_SCOPE(NavVolume::DebugDraw);
+			
+			for (const FTile& Tile : Tiles)
+			{
+				if (!bBuiltTilesOnly || BuiltTileKeys.Contains(Tile.Key))
+				{
+					Tile.Octree->DebugDraw(World, FColor::Red, FColor::Green, LifeTime);
+				}
+			}
+#endif // WITH_EDITOR
+		}
+
+	private:
+		/** Adds the voxels on the faces of a solid block that lie in [RangeMin, RangeMax] - the interior grows no further than its faces. */
+		static void AddSolidFaceVoxels(const FMortonCode Code, const int32 Log2Size, const FIntVector& RangeMin, const FIntVector& RangeMax, TArray<FMortonCode>& OutLeaves)
+		{
+			const FIntVector BlockMin = DecodeMorton(Code << (3 * Log2Size));
+			const FIntVector BlockMax = BlockMin + FIntVector((1 << Log2Size) - 1);
+			const FIntVector Min(FMath::Max(BlockMin.X, RangeMin.X), FMath::Max(BlockMin.Y, RangeMin.Y), FMath::Max(BlockMin.Z, RangeMin.Z));
+			const FIntVector Max(FMath::Min(BlockMax.X, RangeMax.X), FMath::Min(BlockMax.Y, RangeMax.Y), FMath::Min(BlockMax.Z, RangeMax.Z));
+
+			for (int32 X = Min.X; X <= Max.X; ++X)
+			for (int32 Y = Min.Y; Y <= Max.Y; ++Y)
+			{
+				// A column on an X or Y face is all face, any other only has its two ends
+				if (X == BlockMin.X || X == BlockMax.X || Y == BlockMin.Y || Y == BlockMax.Y)
+				{
+					for (int32 Z = Min.Z; Z <= Max.Z; ++Z) OutLeaves.Add(EncodeMorton(X, Y, Z));
+					continue;
+				}
+
+				if (Min.Z == BlockMin.Z) OutLeaves.Add(EncodeMorton(X, Y, BlockMin.Z));
+				if (Max.Z == BlockMax.Z) OutLeaves.Add(EncodeMorton(X, Y, BlockMax.Z));
+			}
+		}
+
+		void RemoveTile(const FMortonCode Key)
+		{
+			int32 TileIndex;
+
+			if (TileIndices.RemoveAndCopyValue(Key, TileIndex))
+			{
+				Tiles.RemoveAtSwap(TileIndex, 1, EAllowShrinking::No);
+
+				if (Tiles.IsValidIndex(TileIndex))
+				{
+					TileIndices[Tiles[TileIndex].Key] = TileIndex;
+				}
+			}
+		}
+
+		/** Collects the free face of an element in a tile and tags the results with the tile. */
+		FORCEINLINE void CollectTileFace(const int32 TileIndex, const FNodeLink Link, const int32 Direction, TArray<FNodeLink>& OutLinks) const
+		{
+			const int32 NumCollected = OutLinks.Num();
+			Tiles[TileIndex].Octree->CollectFreeFace(Link, Direction, OutLinks);
+
+			for (int32 Index = NumCollected; Index < OutLinks.Num(); ++Index)
+			{
+				OutLinks[Index] = OutLinks[Index].WithTile(TileIndex);
+			}
+		}
+
+		int32 TileLog2Size;
+		TArray<FTile> Tiles;
+		TMap<FMortonCode, int32> TileIndices;
+		FNavVolumeBuildStats BuildStats;
+
+		/** Range of tiles covered by the bounds, inclusive - empty until SetBounds. */
+		FIntVector MinTile = FIntVector(0);
+		FIntVector MaxTile = FIntVector(-1);
+
+		/** Tiles of the bounds without data - their streaming cell is unloaded, or they didn't fit in MaxNumTiles. */
+		TSet<FMortonCode> UnloadedTileKeys;
+
+		/** Tiles the last BuildTiles built - what a debug draw of an update redraws. Reset by RemoveTiles. */
+		TSet<FMortonCode> BuiltTileKeys;
+	};
+} // namespace NavVolume::Tile
@@ -13,6 +13,57 @@ namespace NavVolume::Voxel
 		static constexpr float InvVoxelSize = 1.0 / VoxelSize;
 	};
 
+	/** Voxel sizes every template on VoxelSize is compiled for - a volume picks one of them at runtime. */
+	inline constexpr int32 SupportedVoxelSizes[] = { 16, 32, 64, 128 };
+
+	constexpr bool IsSupportedVoxelSize(const int32 VoxelSize)
+	{
+		for (const int32 SupportedSize : SupportedVoxelSizes)
+		{
+			if (SupportedSize == VoxelSize) return true;
+		}
+		
+		return false;
+	}
+
+	/** The supported size closest to VoxelSize, the smaller one on a tie - for sizes typed in by hand. */
+	constexpr int32 GetNearestSupportedVoxelSize(const int32 VoxelSize)
+	{
+		int32 Nearest = SupportedVoxelSizes[0];
+
+		for (const int32 SupportedSize : SupportedVoxelSizes)
+		{
+			if (FMath::Abs(SupportedSize - VoxelSize) < FMath::Abs(Nearest - VoxelSize)) Nearest = SupportedSize;
+		}
+		
+		return Nearest;
+	}
+
+	/** Calls Functor with a TIntegralConstant of the voxel size, so a size chosen at runtime runs code compiled for it.
+	 *	The switch is paid once per call - everything the functor instantiates is specialised and inlined for the size.
+	 */
+	template<typename FunctorType>
+	decltype(auto) DispatchVoxelSize(const int32 VoxelSize, FunctorType&& Functor)
+	{
+		switch (VoxelSize)
+		{
+		case 16: return Functor(TIntegralConstant<int32, 16>());
+		case 64: return Functor(TIntegralConstant<int32, 64>());
+		case 128: return Functor(TIntegralConstant<int32, 128>());
+		default:
+			checkf(VoxelSize == 32, TEXT("Unsupported voxel size %d"), VoxelSize);
+			return Functor(TIntegralConstant<int32, 32>());
+		}
+	}
+
+	/** Conservative result of testing a whole block of voxels against a shape. */
+	enum class EBlockTest : uint8
+	{
+		Outside,	// No voxel in the block can be inside
+		Inside,		// Every voxel in the block is inside
+		Intersect	// Unknown - the block has to be split further
+	};
+
 	template<int32 VoxelSize, typename ShapeType>
 	struct TShapeTest
 	{
@@ -22,17 +73,35 @@ namespace NavVolume::Voxel
 	template<int32 VoxelSize>
 	struct TShapeTest<VoxelSize, FKSphereElem>
 	{
+		float Radius;
 		float RadiusSquared;
 			
 		TShapeTest(const FKSphereElem& SphereShape)
 		{
-			RadiusSquared = FMath::Square(SphereShape.Radius + TVoxelTraits<VoxelSize>::HalfVoxelSize);
+			Radius = SphereShape.Radius + TVoxelTraits<VoxelSize>::HalfVoxelSize;
+			RadiusSquared = FMath::Square(Radius);
 		}
 
 		FORCEINLINE bool IsInside(const FVector& LocalPosition) const
 		{
 			return LocalPosition.SizeSquared() <= RadiusSquared;
 		}
+
+		/** Tests 4 positions stored as SoA lanes - bit N of the result is set if lane N is inside. */
+		FORCEINLINE int32 IsInside4(const VectorRegister4Float& X, const VectorRegister4Float& Y, const VectorRegister4Float& Z) const
+		{
+			const VectorRegister4Float DistanceSquared = VectorMultiplyAdd(X, X, VectorMultiplyAdd(Y, Y, VectorMultiply(Z, Z)));
+			return VectorMaskBits(VectorCompareLE(DistanceSquared, VectorSetFloat1(RadiusSquared)));
+		}
+
+		/** Tests a sphere enclosing every voxel center of a block. */
+		FORCEINLINE EBlockTest TestBlock(const FVector& LocalCenter, const double LocalRadius) const
+		{
+			const double Distance = LocalCenter.Size();
+			if (Distance - LocalRadius > Radius) return EBlockTest::Outside;
+			if (Distance + LocalRadius <= Radius) return EBlockTest::Inside;
+			return EBlockTest::Intersect;
+		}
 	};
 
 	template<int32 VoxelSize>
@@ -55,17 +124,50 @@ namespace NavVolume::Voxel
 				   FMath::Abs(LocalPosition.Y) <= HalfExtentY &&
 				   FMath::Abs(LocalPosition.Z) <= HalfExtentZ ;
 		}
+
+		/** Tests 4 positions stored as SoA lanes - bit N of the result is set if lane N is inside. */
+		FORCEINLINE int32 IsInside4(const VectorRegister4Float& X, const VectorRegister4Float& Y, const VectorRegister4Float& Z) const
+		{
+			const VectorRegister4Float InsideX = VectorCompareLE(VectorAbs(X), VectorSetFloat1(HalfExtentX));
+			const VectorRegister4Float InsideY = VectorCompareLE(VectorAbs(Y), VectorSetFloat1(HalfExtentY));
+			const VectorRegister4Float InsideZ = VectorCompareLE(VectorAbs(Z), VectorSetFloat1(HalfExtentZ));
+			return VectorMaskBits(VectorBitwiseAnd(InsideX, VectorBitwiseAnd(InsideY, InsideZ)));
+		}
+
+		/** Tests a sphere enclosing every voxel center of a block. */
+		FORCEINLINE EBlockTest TestBlock(const FVector& LocalCenter, const double LocalRadius) const
+		{
+			const FVector AbsCenter = LocalCenter.GetAbs();
+			
+			if (AbsCenter.X - LocalRadius > HalfExtentX ||
+				AbsCenter.Y - LocalRadius > HalfExtentY ||
+				AbsCenter.Z - LocalRadius > HalfExtentZ)
+			{
+				return EBlockTest::Outside;
+			}
+
+			if (AbsCenter.X + LocalRadius <= HalfExtentX &&
+				AbsCenter.Y + LocalRadius <= HalfExtentY &&
+				AbsCenter.Z + LocalRadius <= HalfExtentZ)
+			{
+				return EBlockTest::Inside;
+			}
+			
+			return EBlockTest::Intersect;
+		}
 	};
 
 	template<int32 VoxelSize>
 	struct TShapeTest<VoxelSize, FKSphylElem>
 	{
+		float Radius;
 		float RadiusSquared;
 		float HalfLength;
 			
 		TShapeTest(const FKSphylElem& CapsuleShape)
 		{
-			RadiusSquared = FMath::Square(CapsuleShape.Radius + TVoxelTraits<VoxelSize>::HalfVoxelSize);
+			Radius = CapsuleShape.Radius + TVoxelTraits<VoxelSize>::HalfVoxelSize;
+			RadiusSquared = FMath::Square(Radius);
 			HalfLength = 0.5 * CapsuleShape.Length; // This is not extended because RadiusSquared already considers the voxel overestimation
 		}
 
@@ -74,12 +176,32 @@ namespace NavVolume::Voxel
 			const FVector ClosestPointOnLine(0, 0, FMath::Clamp(LocalPosition.Z, -HalfLength, HalfLength));
 			return (ClosestPointOnLine - LocalPosition).SizeSquared() <= RadiusSquared;
 		}
+
+		/** Tests 4 positions stored as SoA lanes - bit N of the result is set if lane N is inside. */
+		FORCEINLINE int32 IsInside4(const VectorRegister4Float& X, const VectorRegister4Float& Y, const VectorRegister4Float& Z) const
+		{
+			const VectorRegister4Float ClosestZ = VectorMin(VectorMax(Z, VectorSetFloat1(-HalfLength)), VectorSetFloat1(HalfLength));
+			const VectorRegister4Float DeltaZ = VectorSubtract(Z, ClosestZ);
+			const VectorRegister4Float DistanceSquared = VectorMultiplyAdd(X, X, VectorMultiplyAdd(Y, Y, VectorMultiply(DeltaZ, DeltaZ)));
+			return VectorMaskBits(VectorCompareLE(DistanceSquared, VectorSetFloat1(RadiusSquared)));
+		}
+
+		/** Tests a sphere enclosing every voxel center of a block. */
+		FORCEINLINE EBlockTest TestBlock(const FVector& LocalCenter, const double LocalRadius) const
+		{
+			const FVector ClosestPointOnLine(0, 0, FMath::Clamp(LocalCenter.Z, -HalfLength, HalfLength));
+			const double Distance = (ClosestPointOnLine - LocalCenter).Size();
+			if (Distance - LocalRadius > Radius) return EBlockTest::Outside;
+			if (Distance + LocalRadius <= Radius) return EBlockTest::Inside;
+			return EBlockTest::Intersect;
+		}
 	};
 
 	template<int32 VoxelSize>
 	struct TShapeTest<VoxelSize, FKConvexElem>
 	{
 		FConvexVolume ConvexVolume;
+		TArray<FVector4f> FloatPlanes; // Single precision copy of the planes for IsInside4
 			
 		TShapeTest(const FKConvexElem& ConvexShape)
 		{
@@ -88,14 +210,130 @@ namespace NavVolume::Voxel
 			ConvexShape.GetPlanes(TempPlanes);
 			ConvexVolume.Planes.Append(MoveTemp(TempPlanes));
 			ConvexVolume.Init();
+
+			FloatPlanes.Reserve(ConvexVolume.Planes.Num());
+			
+			for (const FPlane& Plane : ConvexVolume.Planes)
+			{
+				FloatPlanes.Emplace(static_cast<float>(Plane.X), static_cast<float>(Plane.Y), static_cast<float>(Plane.Z), static_cast<float>(Plane.W));
+			}
 		}
 
 		FORCEINLINE bool IsInside(const FVector& LocalPosition) const
 		{
 			return ConvexVolume.IntersectSphere(LocalPosition, TVoxelTraits<VoxelSize>::HalfVoxelSize);
 		}
+
+		/** Tests 4 positions stored as SoA lanes - bit N of the result is set if lane N is inside. */
+		FORCEINLINE int32 IsInside4(const VectorRegister4Float& X, const VectorRegister4Float& Y, const VectorRegister4Float& Z) const
+		{
+			const VectorRegister4Float HalfVoxelSize = VectorSetFloat1(TVoxelTraits<VoxelSize>::HalfVoxelSize);
+			int32 Mask = 0xF;
+			
+			for (const FVector4f& Plane : FloatPlanes)
+			{
+				// PlaneDot - distance along the outward facing normal
+				VectorRegister4Float Distance = VectorMultiplyAdd(X, VectorSetFloat1(Plane.X), VectorSetFloat1(-Plane.W));
+				Distance = VectorMultiplyAdd(Y, VectorSetFloat1(Plane.Y), Distance);
+				Distance = VectorMultiplyAdd(Z, VectorSetFloat1(Plane.Z), Distance);
+				
+				Mask &= VectorMaskBits(VectorCompareLE(Distance, HalfVoxelSize));
+
+				if (Mask == 0)
+				{
+					break;
+				}
+			}
+			
+			return Mask;
+		}
+
+		/** Tests a sphere enclosing every voxel center of a block - the plane normals face outwards. */
+		FORCEINLINE EBlockTest TestBlock(const FVector& LocalCenter, const double LocalRadius) const
+		{
+			bool bInside = true;
+			
+			for (const FPlane& Plane : ConvexVolume.Planes)
+			{
+				const double Distance = Plane.PlaneDot(LocalCenter);
+				if (Distance - LocalRadius > TVoxelTraits<VoxelSize>::HalfVoxelSize) return EBlockTest::Outside;
+				bInside &= Distance + LocalRadius <= TVoxelTraits<VoxelSize>::HalfVoxelSize;
+			}
+			
+			return bInside ? EBlockTest::Inside : EBlockTest::Intersect;
+		}
 	};
 	
+	/** Overlap of a triangle with axis aligned boxes of one size (Schwarz and Seidel 2010, see the omnigoat write-up in the README).
+	 *	The plane and the 3 edge functions of each axis projection are set up once per triangle, so each box costs a few dot products.
+	 */
+	struct FTriangleBoxTest
+	{
+		FTriangleBoxTest(const FVector& V0, const FVector& V1, const FVector& V2, const double BoxSize)
+		{
+			const FVector Vertices[3] = { V0, V1, V2 };
+			const FVector Edges[3] = { V1 - V0, V2 - V1, V0 - V2 };
+			
+			Normal = FVector::CrossProduct(Edges[0], V2 - V0);
+			bDegenerate = Normal.IsNearlyZero(UE_DOUBLE_SMALL_NUMBER);
+
+			// Box corner furthest along the normal, and the opposite one
+			const FVector Critical(Normal.X > 0.0 ? BoxSize : 0.0, Normal.Y > 0.0 ? BoxSize : 0.0, Normal.Z > 0.0 ? BoxSize : 0.0);
+			PlaneD1 = FVector::DotProduct(Normal, Critical - V0);
+			PlaneD2 = FVector::DotProduct(Normal, FVector(BoxSize) - Critical - V0);
+
+			// Projections onto XY, YZ and ZX - each axis pair is (A, B) = (Axis, (Axis + 1) % 3) and faces along the remaining axis
+			for (int32 Projection = 0; Projection < 3; ++Projection)
+			{
+				const int32 A = Projection;
+				const int32 B = (Projection + 1) % 3;
+				const double Sign = Normal[(Projection + 2) % 3] >= 0.0 ? 1.0 : -1.0;
+
+				for (int32 Edge = 0; Edge < 3; ++Edge)
+				{
+					const FVector2D EdgeNormal = FVector2D(-Edges[Edge][B], Edges[Edge][A]) * Sign;
+					EdgeNormals[Projection][Edge] = EdgeNormal;
+					EdgeDistances[Projection][Edge] = -(EdgeNormal.X * Vertices[Edge][A] + EdgeNormal.Y * Vertices[Edge][B])
+						+ FMath::Max(0.0, BoxSize * EdgeNormal.X) + FMath::Max(0.0, BoxSize * EdgeNormal.Y);
+				}
+			}
+		}
+
+		/** True if the box with this minimum corner touches the triangle. */
+		FORCEINLINE bool Overlaps(const FVector& BoxMin) const
+		{
+			const double PlaneDistance = FVector::DotProduct(Normal, BoxMin);
+			
+			if (bDegenerate || (PlaneDistance + PlaneD1) * (PlaneDistance + PlaneD2) > 0.0)
+			{
+				return false;
+			}
+
+			for (int32 Projection = 0; Projection < 3; ++Projection)
+			{
+				const FVector2D Point(BoxMin[Projection], BoxMin[(Projection + 1) % 3]);
+
+				for (int32 Edge = 0; Edge < 3; ++Edge)
+				{
+					if (FVector2D::DotProduct(EdgeNormals[Projection][Edge], Point) + EdgeDistances[Projection][Edge] < 0.0)
+					{
+						return false;
+					}
+				}
+			}
+
+			return true;
+		}
+
+	private:
+		FVector Normal;
+		double PlaneD1;
+		double PlaneD2;
+		FVector2D EdgeNormals[3][3];
+		double EdgeDistances[3][3];
+		bool bDegenerate;
+	};
+
 	/** Snaps a point to the voxel grid - axis aligned. */
 	template<int32 VoxelSize, typename VectorType>
 	FORCEINLINE FIntVector SnapToVoxelAxis(const VectorType& Vector) 
@@ -129,38 +367,335 @@ namespace NavVolume::Voxel
 		);
 	}
 
-	/** If an appropriate test exists for the passed shape it will be voxelized by transforming bounded world coordinates into local space and testing intersection. */
+	/** Blocks are split down to this size (4x4x4 voxels) at most before each voxel is tested individually. */
+	constexpr int32 LeafBlockLog2Size = 2;
+
+	/** Builds the matrix that transforms world space voxels into the geometry's local space.
+	 *	NOTE: Non-uniform scaling necessitates using FMatrix over FTransform for this use case
+	 */
+	template<typename ShapeType, typename TransformType>
+	FORCEINLINE FMatrix GetWorldToLocal(const ShapeType& Shape, TransformType&& WorldTransform)
+	{
+		const FMatrix LocalToWorld = (Shape.GetTransform() * WorldTransform).ToMatrixWithScale();
+		return LocalToWorld.Inverse();
+	}
+
+	/** The quantized (inclusive) voxel range covered by the bounds, expanded to align with the voxel grid. */
+	template<int32 VoxelSize, typename BoundsType>
+	FORCEINLINE void GetVoxelRange(BoundsType&& WorldBounds, FIntVector& OutVoxelMin, FIntVector& OutVoxelMax)
+	{
+		OutVoxelMin = SnapToVoxelAxis<VoxelSize>(WorldBounds.Min - TVoxelTraits<VoxelSize>::HalfVoxelSize) / VoxelSize;
+		OutVoxelMax = SnapToVoxelAxis<VoxelSize>(WorldBounds.Max + TVoxelTraits<VoxelSize>::HalfVoxelSize) / VoxelSize;
+	}
+
+	/** World bounds that GetVoxelRange maps back to exactly the inclusive quantized range [VoxelMin, VoxelMax]. */
+	template<int32 VoxelSize>
+	FORCEINLINE FBox GetVoxelRangeBounds(const FIntVector& VoxelMin, const FIntVector& VoxelMax)
+	{
+		// GetVoxelRange rounds half up after expanding by half a voxel - stay just short of the next voxel on the max side
+		return FBox(FVector(DequantizeVoxel<VoxelSize>(VoxelMin)), FVector(DequantizeVoxel<VoxelSize>(VoxelMax)) - FVector(1.0));
+	}
+
+	struct FRaycastRequest
+	{
+		FVector Start;
+		FVector End;
+	};
+
+	struct FRaycastHit
+	{
+		bool bBlocked = false;
+		
+		/** Fraction of the segment travelled before the hit, 1 if it is clear. */
+		double Time = 1.0;
+		FVector Location = FVector::ZeroVector;
+	};
+
+	/** A segment in voxel space, where voxel N covers [N, N + 1) on each axis - node bounds come straight from integer voxel ranges. */
+	struct FVoxelRay
+	{
+		FVector Origin;
+		FVector Direction;
+		FVector InvDirection;
+
+		/** Children of a node are visited in the order Octant ^ OctantMask - along a ray each axis bit only ever flips one way,
+		 *	so that order is front to back whatever the direction.
+		 */
+		int32 OctantMask;
+
+		template<int32 VoxelSize>
+		static FVoxelRay Make(const FVector& Start, const FVector& End)
+		{
+			FVoxelRay Ray;
+			Ray.Origin = Start * TVoxelTraits<VoxelSize>::InvVoxelSize + FVector(0.5);
+			Ray.Direction = (End - Start) * TVoxelTraits<VoxelSize>::InvVoxelSize;
+			Ray.OctantMask = 0;
+
+			for (int32 Axis = 0; Axis < 3; ++Axis)
+			{
+				// A huge inverse instead of infinity keeps the slab test free of NaNs when the origin lies on a slab
+				Ray.InvDirection[Axis] = FMath::Abs(Ray.Direction[Axis]) > UE_DOUBLE_SMALL_NUMBER ? 1.0 / Ray.Direction[Axis]
+					: (Ray.Direction[Axis] < 0.0 ? -UE_BIG_NUMBER : UE_BIG_NUMBER);
+				Ray.OctantMask |= Ray.Direction[Axis] < 0.0 ? 1 << Axis : 0;
+			}
+
+			return Ray;
+		}
+
+		/** Slab test against the cube of 2^Log2Size voxels at VoxelMin - OutTime is where the segment enters it, clamped to the start. */
+		FORCEINLINE bool Intersects(const FIntVector& VoxelMin, const int32 Log2Size, double& OutTime) const
+		{
+			const FVector BoxMin = FVector(VoxelMin);
+			const FVector T0 = (BoxMin - Origin) * InvDirection;
+			const FVector T1 = (BoxMin + FVector(1 << Log2Size) - Origin) * InvDirection;
+
+			const double Enter = FMath::Max3(FMath::Min(T0.X, T1.X), FMath::Min(T0.Y, T1.Y), FMath::Min(T0.Z, T1.Z));
+			const double Exit = FMath::Min3(FMath::Max(T0.X, T1.X), FMath::Max(T0.Y, T1.Y), FMath::Max(T0.Z, T1.Z));
+
+			OutTime = FMath::Max(Enter, 0.0);
+			return OutTime <= FMath::Min(Exit, 1.0);
+		}
+
+		/** Voxel offset of an octant of a cube of 2^Log2Size voxels - the low 3 bits of a morton code are X, Y and Z. */
+		static FORCEINLINE FIntVector GetOctantOffset(const int32 Octant, const int32 Log2Size)
+		{
+			return FIntVector(Octant & 1, Octant >> 1 & 1, Octant >> 2 & 1) * (1 << Log2Size);
+		}
+	};
+
+	/** Tests every voxel of an inclusive quantized range, 4 voxels along Z at a time.
+	 *	The grid is regular so local positions are found incrementally (base + k * step) instead of a matrix multiply per voxel.
+	 */
+	template<int32 VoxelSize, typename ShapeTestType, typename ForEachFunc>
+	void VoxelizeRange(const ShapeTestType& ShapeTest, const FMatrix& WorldToLocal, const FIntVector& VoxelMin, const FIntVector& VoxelMax, ForEachFunc&& ForEachVoxel)
+	{
+		const FVector LocalMin = WorldToLocal.TransformPosition(FVector(DequantizeVoxel<VoxelSize>(VoxelMin)));
+		const FVector LocalStepX = WorldToLocal.TransformVector(FVector(VoxelSize, 0, 0));
+		const FVector LocalStepY = WorldToLocal.TransformVector(FVector(0, VoxelSize, 0));
+		const FVector LocalStepZ = WorldToLocal.TransformVector(FVector(0, 0, VoxelSize));
+
+		// Offsets of the 4 lanes along Z - each lane is one voxel further than the last
+		const VectorRegister4Float LaneIndex = MakeVectorRegisterFloat(0.f, 1.f, 2.f, 3.f);
+		const VectorRegister4Float LaneStepX = VectorMultiply(LaneIndex, VectorSetFloat1(LocalStepZ.X));
+		const VectorRegister4Float LaneStepY = VectorMultiply(LaneIndex, VectorSetFloat1(LocalStepZ.Y));
+		const VectorRegister4Float LaneStepZ = VectorMultiply(LaneIndex, VectorSetFloat1(LocalStepZ.Z));
+		
+		for (int32 X = VoxelMin.X; X <= VoxelMax.X; ++X)
+		for (int32 Y = VoxelMin.Y; Y <= VoxelMax.Y; ++Y)
+		{
+			const FVector LocalRow = LocalMin + LocalStepX * (X - VoxelMin.X) + LocalStepY * (Y - VoxelMin.Y);
+			
+			for (int32 Z = VoxelMin.Z; Z <= VoxelMax.Z; Z += 4)
+			{
+				const FVector LocalStart = LocalRow + LocalStepZ * (Z - VoxelMin.Z);
+				const int32 NumLanes = FMath::Min(4, VoxelMax.Z - Z + 1);
+				
+				int32 Mask = ShapeTest.IsInside4(
+					VectorAdd(VectorSetFloat1(LocalStart.X), LaneStepX),
+					VectorAdd(VectorSetFloat1(LocalStart.Y), LaneStepY),
+					VectorAdd(VectorSetFloat1(LocalStart.Z), LaneStepZ)
+				);
+				
+				Mask &= (1 << NumLanes) - 1;
+
+				while (Mask != 0)
+				{
+					const int32 Lane = FMath::CountTrailingZeros(static_cast<uint32>(Mask));
+					Mask &= Mask - 1;
+					ForEachVoxel(DequantizeVoxel<VoxelSize>(FIntVector(X, Y, Z + Lane)));
+				}
+			}
+		}
+	}
+
+	/** Tests every voxel in the snapped world bounds - kept as the reference the hierarchical path is compared against. */
 	template<int32 VoxelSize, typename ShapeType, typename TransformType, typename BoundsType, typename ForEachFunc>
-	void Voxelize(const ShapeType& Shape, TransformType&& WorldTransform, BoundsType&& WorldBounds, ForEachFunc&& ForEachVoxel)
+	void VoxelizeDense(const ShapeType& Shape, TransformType&& WorldTransform, BoundsType&& WorldBounds, ForEachFunc&& ForEachVoxel)
 	{
 		const TShapeTest<VoxelSize, ShapeType>ShapeTest(Shape);
 		
 		// Calculate the inverse matrix to transform voxels from world space into the geometry's local space
-		// NOTE: Non-uniform scaling necessitates using FMatrix over FTransform for this use case
-		const FMatrix LocalToWorld = (Shape.GetTransform() * WorldTransform).ToMatrixWithScale();
-		const FMatrix WorldToLocal = LocalToWorld.Inverse();
+		const FMatrix WorldToLocal = GetWorldToLocal(Shape, Forward<TransformType>(WorldTransform));
 
 		// Expand the AABB to align with the voxel grid
-		const FIntVector VoxelMin = SnapToVoxelAxis<VoxelSize>(WorldBounds.Min - TVoxelTraits<VoxelSize>::HalfVoxelSize);
-		const FIntVector VoxelMax = SnapToVoxelAxis<VoxelSize>(WorldBounds.Max + TVoxelTraits<VoxelSize>::HalfVoxelSize);
+		FIntVector VoxelMin, VoxelMax;
+		GetVoxelRange<VoxelSize>(Forward<BoundsType>(WorldBounds), VoxelMin, VoxelMax);
+		
+		VoxelizeRange<VoxelSize>(ShapeTest, WorldToLocal, VoxelMin, VoxelMax, Forward<ForEachFunc>(ForEachVoxel));
+	}
+
+	/** Voxelizes by recursively splitting morton aligned blocks into octants - each block is classified as a whole first.
+	 *	Outside blocks are skipped, blocks proven inside are passed to ForEachBlock(QuantizedMin, Log2Size) without testing a single voxel,
+	 *	and only blocks straddling the surface are split down to voxel resolution.
+	 *	As blocks are morton aligned, the codes of a block form the contiguous range [EncodeMorton(QuantizedMin), + 8^Log2Size).
+	 *	Blocks for which IsBlockCovered(QuantizedMin, Log2Size) is true are already fully occupied (e.g. by another shape) and skipped untested.
+	 */
+	template<int32 VoxelSize, typename ShapeType, typename TransformType, typename BoundsType, typename ForEachVoxelFunc, typename ForEachBlockFunc, typename IsBlockCoveredFunc>
+	void VoxelizeHierarchical(const ShapeType& Shape, TransformType&& WorldTransform, BoundsType&& WorldBounds, ForEachVoxelFunc&& ForEachVoxel, ForEachBlockFunc&& ForEachBlock,
+		IsBlockCoveredFunc&& IsBlockCovered)
+	{
+		using FTraits = TVoxelTraits<VoxelSize>;
+		
+		const TShapeTest<VoxelSize, ShapeType> ShapeTest(Shape);
+		const FMatrix WorldToLocal = GetWorldToLocal(Shape, Forward<TransformType>(WorldTransform));
 
-		for (int32 X = VoxelMin.X; X <= VoxelMax.X; X += VoxelSize)
-		for (int32 Y = VoxelMin.Y; Y <= VoxelMax.Y; Y += VoxelSize)
-		for (int32 Z = VoxelMin.Z; Z <= VoxelMax.Z; Z += VoxelSize)
+		// Upper bound on how much WorldToLocal can stretch a distance (the frobenius norm is never less than the largest singular value)
+		const double LocalScale = FMath::Sqrt(
+			WorldToLocal.GetScaledAxis(EAxis::X).SizeSquared() +
+			WorldToLocal.GetScaledAxis(EAxis::Y).SizeSquared() +
+			WorldToLocal.GetScaledAxis(EAxis::Z).SizeSquared()
+		);
+		
+		FIntVector VoxelMin, VoxelMax;
+		GetVoxelRange<VoxelSize>(Forward<BoundsType>(WorldBounds), VoxelMin, VoxelMax);
+
+		const auto VisitVoxels = [&](const FIntVector& Min, const FIntVector& Max, const bool bInside)
+		{
+			if (!bInside)
+			{
+				VoxelizeRange<VoxelSize>(ShapeTest, WorldToLocal, Min, Max, ForEachVoxel);
+				return;
+			}
+			
+			for (int32 X = Min.X; X <= Max.X; ++X)
+			for (int32 Y = Min.Y; Y <= Max.Y; ++Y)
+			for (int32 Z = Min.Z; Z <= Max.Z; ++Z)
+			{
+				ForEachVoxel(DequantizeVoxel<VoxelSize>(FIntVector(X, Y, Z)));
+			}
+		};
+		
+		const auto VisitBlock = [&](const auto& Self, const FIntVector& BlockMin, const int32 Log2Size) -> void
+		{
+			const int32 Size = 1 << Log2Size;
+			const FIntVector BlockMax = BlockMin + FIntVector(Size - 1);
+
+			// Only the part of the block inside the bounds is ever emitted
+			const FIntVector ClipMin(FMath::Max(BlockMin.X, VoxelMin.X), FMath::Max(BlockMin.Y, VoxelMin.Y), FMath::Max(BlockMin.Z, VoxelMin.Z));
+			const FIntVector ClipMax(FMath::Min(BlockMax.X, VoxelMax.X), FMath::Min(BlockMax.Y, VoxelMax.Y), FMath::Min(BlockMax.Z, VoxelMax.Z));
+
+			if (ClipMin.X > ClipMax.X || ClipMin.Y > ClipMax.Y || ClipMin.Z > ClipMax.Z || IsBlockCovered(BlockMin, Log2Size))
+			{
+				return;
+			}
+			
+			// Sphere enclosing the voxel centers of the block
+			const FVector WorldCenter = FVector(DequantizeVoxel<VoxelSize>(BlockMin)) + FVector((Size - 1) * FTraits::HalfVoxelSize);
+			const double WorldRadius = (Size - 1) * FTraits::HalfVoxelSize * UE_DOUBLE_SQRT_3;
+			
+			const EBlockTest BlockTest = ShapeTest.TestBlock(WorldToLocal.TransformPosition(WorldCenter), WorldRadius * LocalScale);
+			
+			if (BlockTest == EBlockTest::Outside)
+			{
+				return;
+			}
+
+			const bool bClipped = ClipMin != BlockMin || ClipMax != BlockMax;
+			
+			if (BlockTest == EBlockTest::Inside && !bClipped)
+			{
+				ForEachBlock(BlockMin, Log2Size);
+			}
+			else if (BlockTest == EBlockTest::Inside || Log2Size <= LeafBlockLog2Size)
+			{
+				VisitVoxels(ClipMin, ClipMax, BlockTest == EBlockTest::Inside);
+			}
+			else
+			{
+				const int32 HalfSize = Size >> 1;
+				
+				for (int32 Octant = 0; Octant < 8; ++Octant)
+				{
+					const FIntVector ChildOffset((Octant & 1) * HalfSize, (Octant >> 1 & 1) * HalfSize, (Octant >> 2 & 1) * HalfSize);
+					Self(Self, BlockMin + ChildOffset, Log2Size - 1);
+				}
+			}
+		};
+
+		// Root blocks are aligned to their own size so every block below them is morton aligned - at most 2 are needed per axis
+		const FIntVector NumVoxels = VoxelMax - VoxelMin + FIntVector(1);
+		const int32 RootLog2Size = FMath::CeilLogTwo(static_cast<uint32>(FMath::Max3(NumVoxels.X, NumVoxels.Y, NumVoxels.Z)));
+		const int32 RootMask = ~((1 << RootLog2Size) - 1);
+		
+		for (int32 X = VoxelMin.X & RootMask; X <= VoxelMax.X; X += 1 << RootLog2Size)
+		for (int32 Y = VoxelMin.Y & RootMask; Y <= VoxelMax.Y; Y += 1 << RootLog2Size)
+		for (int32 Z = VoxelMin.Z & RootMask; Z <= VoxelMax.Z; Z += 1 << RootLog2Size)
+		{
+			VisitBlock(VisitBlock, FIntVector(X, Y, Z), RootLog2Size);
+		}
+	}
+
+	template<int32 VoxelSize, typename ShapeType, typename TransformType, typename BoundsType, typename ForEachVoxelFunc, typename ForEachBlockFunc>
+	FORCEINLINE void VoxelizeHierarchical(const ShapeType& Shape, TransformType&& WorldTransform, BoundsType&& WorldBounds, ForEachVoxelFunc&& ForEachVoxel, ForEachBlockFunc&& ForEachBlock)
+	{
+		VoxelizeHierarchical<VoxelSize>(
+			Shape,
+			Forward<TransformType>(WorldTransform),
+			Forward<BoundsType>(WorldBounds),
+			Forward<ForEachVoxelFunc>(ForEachVoxel),
+			Forward<ForEachBlockFunc>(ForEachBlock),
+			[](const FIntVector&, const int32) { return false; }
+		);
+	}
+
+	/** Voxelizes the surface of a triangle within an inclusive quantized range - a triangle soup has no inside, so only voxels whose cell
+	 *	touches the triangle are passed to ForEachVoxel. The range is covered in aligned 4x4x4 blocks, each tested as a whole before its voxels.
+	 */
+	template<int32 VoxelSize, typename ForEachVoxelFunc, typename IsBlockCoveredFunc>
+	void VoxelizeTriangle(const FVector& V0, const FVector& V1, const FVector& V2, const FIntVector& VoxelMin, const FIntVector& VoxelMax,
+		ForEachVoxelFunc&& ForEachVoxel, IsBlockCoveredFunc&& IsBlockCovered)
+	{
+		constexpr int32 BlockSize = 1 << LeafBlockLog2Size;
+		
+		const FTriangleBoxTest BlockTest(V0, V1, V2, VoxelSize * BlockSize);
+		const FTriangleBoxTest VoxelTest(V0, V1, V2, VoxelSize);
+
+		// A voxel's position is the center of its cell
+		const auto GetCellMin = [](const FIntVector& Voxel) { return FVector(DequantizeVoxel<VoxelSize>(Voxel)) - FVector(TVoxelTraits<VoxelSize>::HalfVoxelSize); };
+		
+		const int32 BlockMask = ~(BlockSize - 1);
+
+		for (int32 BlockX = VoxelMin.X & BlockMask; BlockX <= VoxelMax.X; BlockX += BlockSize)
+		for (int32 BlockY = VoxelMin.Y & BlockMask; BlockY <= VoxelMax.Y; BlockY += BlockSize)
+		for (int32 BlockZ = VoxelMin.Z & BlockMask; BlockZ <= VoxelMax.Z; BlockZ += BlockSize)
 		{
-			const FVector WorldPosition = FVector(X, Y, Z);
-			const FVector LocalPosition = WorldToLocal.TransformPosition(WorldPosition);
+			const FIntVector BlockMin(BlockX, BlockY, BlockZ);
+			
+			if (IsBlockCovered(BlockMin, LeafBlockLog2Size) || !BlockTest.Overlaps(GetCellMin(BlockMin)))
+			{
+				continue;
+			}
 			
-			if (ShapeTest.IsInside(LocalPosition))
+			for (int32 X = FMath::Max(BlockX, VoxelMin.X); X <= FMath::Min(BlockX + BlockSize - 1, VoxelMax.X); ++X)
+			for (int32 Y = FMath::Max(BlockY, VoxelMin.Y); Y <= FMath::Min(BlockY + BlockSize - 1, VoxelMax.Y); ++Y)
+			for (int32 Z = FMath::Max(BlockZ, VoxelMin.Z); Z <= FMath::Min(BlockZ + BlockSize - 1, VoxelMax.Z); ++Z)
 			{
-				ForEachVoxel(FIntVector(WorldPosition));
+				if (VoxelTest.Overlaps(GetCellMin(FIntVector(X, Y, Z))))
+				{
+					ForEachVoxel(DequantizeVoxel<VoxelSize>(FIntVector(X, Y, Z)));
+				}
 			}
 		}
 	}
 
+	/** If an appropriate test exists for the passed shape it will be voxelized by transforming bounded world coordinates into local space and testing intersection.
+	 *	Voxels are passed to ForEachVoxel by world position, whole blocks proven inside are passed to ForEachBlock (see VoxelizeHierarchical).
+	 */
+	template<int32 VoxelSize, typename ShapeType, typename TransformType, typename BoundsType, typename ForEachVoxelFunc, typename ForEachBlockFunc>
+	FORCEINLINE void Voxelize(const ShapeType& Shape, TransformType&& WorldTransform, BoundsType&& WorldBounds, ForEachVoxelFunc&& ForEachVoxel, ForEachBlockFunc&& ForEachBlock)
+	{
+		VoxelizeHierarchical<VoxelSize>(
+			Shape,
+			Forward<TransformType>(WorldTransform),
+			Forward<BoundsType>(WorldBounds),
+			Forward<ForEachVoxelFunc>(ForEachVoxel),
+			Forward<ForEachBlockFunc>(ForEachBlock)
+		);
+	}
+
 	/** Transform an array of shapes sharing a transform and boundary into a voxel representation. */
-	template<int32 VoxelSize, typename ShapeType, typename AllocatorType, typename TransformType, typename BoundsType, typename ForEachFunc>
-	void Voxelize(const TArray<ShapeType, AllocatorType>& Shapes, TransformType&& WorldTransform, BoundsType&& WorldBounds, ForEachFunc&& ForEachVoxel)
+	template<int32 VoxelSize, typename ShapeType, typename AllocatorType, typename TransformType, typename BoundsType, typename ForEachVoxelFunc, typename ForEachBlockFunc>
+	void Voxelize(const TArray<ShapeType, AllocatorType>& Shapes, TransformType&& WorldTransform, BoundsType&& WorldBounds, ForEachVoxelFunc&& ForEachVoxel, ForEachBlockFunc&& ForEachBlock)
 	{
 		for(const ShapeType& Shape : Shapes)
 		{
@@ -168,7 +703,8 @@ namespace NavVolume::Voxel
 				Shape,
 				Forward<TransformType>(WorldTransform),
 				Forward<BoundsType>(WorldBounds),
-				Forward<ForEachFunc>(ForEachVoxel)
+				Forward<ForEachVoxelFunc>(ForEachVoxel),
+				Forward<ForEachBlockFunc>(ForEachBlock)
 			);
 		}
 	}